@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -35,19 +36,92 @@ struct mbediso_dirent
     int d_type;
 };
 
+/* entry filled by mbediso_readdir_bulk */
+struct mbediso_dirent_info
+{
+    const char* name; /* nul-terminated, stored in the caller's name buffer (valid until it is reused) */
+    uint32_t name_length;
+    int d_type;
+    uint32_t size; /* zero for directories */
+    uint64_t id; /* usable with mbediso_fopen_id; MBEDISO_INVALID_ID for directories */
+};
+
+/* information filled by mbediso_stat */
+struct mbediso_stat
+{
+    int st_type;
+    int64_t st_size; /* zero for directories */
+    int64_t st_offset; /* offset of the file's data in the uncompressed archive image; -1 for directories */
+};
+
 struct mbediso_dir
 {
     struct mbediso_fs* fs;
     struct mbediso_directory* directory;
     struct mbediso_dirent dirent;
     uint32_t entry_index;
+    uint32_t entry_end;
     bool on_heap;
 };
 
+/* return from an mbediso_walk callback to skip the contents of the directory just reported */
+#define MBEDISO_WALK_SKIP 2
+
+/* called for each path found by an enumeration; size is zero for directories. Return nonzero to stop the enumeration. */
+typedef int (*mbediso_path_callback)(void* userdata, const char* path, int d_type, int64_t size);
+
 struct mbediso_dir* mbediso_opendir(struct mbediso_fs* fs, const char* name);
 
+/* opens a directory for reading only the entries whose names start with prefix */
+struct mbediso_dir* mbediso_opendir_prefix(struct mbediso_fs* fs, const char* name, const char* prefix);
+
 int mbediso_closedir(struct mbediso_dir* dir);
 
 const struct mbediso_dirent* mbediso_readdir(struct mbediso_dir* dir);
 
+/**
+ * \brief reads up to max_entries entries at once, storing their names consecutively in name_buffer
+ *
+ * Directory tables store each name as a difference from the one before it, so names cannot be returned as views into the tables; instead, each is rebuilt from the previous one and written once into name_buffer, with no per-entry allocation. May be interleaved with mbediso_readdir. Stops early if the next name does not fit in name_buffer.
+ *
+ * \returns number of entries filled (0 at the end of the directory), or -1 if name_buffer cannot hold even one name
+ **/
+int mbediso_readdir_bulk(struct mbediso_dir* dir, struct mbediso_dirent_info* entries, int max_entries, char* name_buffer, size_t name_buffer_size);
+
 int mbediso_exists(struct mbediso_fs* fs, const char* name);
+
+/**
+ * \brief fills st with the type, size, and archive offset of the entry at name
+ *
+ * Resolves name using loaded directories where possible, and does not load the final directory or open the archive for a file.
+ *
+ * \returns 0 on success, or -1 if the entry does not exist
+ **/
+int mbediso_stat(struct mbediso_fs* fs, const char* name, struct mbediso_stat* st);
+
+/**
+ * \brief calls callback with each path matching a shell-style pattern, such as `*.png` files within `textures/ui`
+ *
+ * Each path segment may use `*`, `?`, and `[...]`; `**` is not supported. Only the entries sharing a segment's literal prefix are visited, and only matching directories are entered. The callback may use the fs, for example to open the paths it is given.
+ *
+ * \returns number of paths passed to callback, or -1 on an invalid pattern or allocation failure
+ **/
+int mbediso_glob(struct mbediso_fs* fs, const char* pattern, mbediso_path_callback callback, void* userdata);
+
+/**
+ * \brief calls callback with each path below the directory root (recursively, reporting each directory before its contents)
+ *
+ * The walk reads loaded directories in place and builds each path incrementally, without any lookups. The callback may use the fs. After mbediso_scanfs, walks of disjoint subtrees may run concurrently on different threads, as mbediso_walk_parallel does.
+ *
+ * \returns number of paths passed to callback, or -1 if root is not a directory or on allocation failure
+ **/
+int mbediso_walk(struct mbediso_fs* fs, const char* root, mbediso_path_callback callback, void* userdata);
+
+/**
+ * \brief like mbediso_walk, but walks the directories directly below root on up to threads threads at once
+ *
+ * Scans the fs first (see mbediso_scanfs). The entries directly below root are reported on the calling thread; each directory among them is then walked by one of the threads (including the calling thread, which walks every subtree itself without thread support). The callback is called concurrently from these threads, so it must be thread-safe; paths within a subtree keep their mbediso_walk order. Once a callback stops the walk, each thread stops within a few paths.
+ *
+ * \returns number of paths passed to callback, or -1 if root is not a directory or on allocation failure
+ **/
+int mbediso_walk_parallel(struct mbediso_fs* fs, const char* root, mbediso_path_callback callback, void* userdata, int threads);
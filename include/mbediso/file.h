@@ -19,18 +19,66 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define MBEDISO_SEEK_SET 0       /**< Seek from the beginning of data */
 #define MBEDISO_SEEK_CUR 1       /**< Seek relative to current read point */
 #define MBEDISO_SEEK_END 2       /**< Seek relative to the end of data */
 
+#define MBEDISO_INVALID_ID (uint64_t)(0xFFFFFFFFFFFFFFFFULL)
+
 struct mbediso_io;
 struct mbediso_fs;
 
+/* custom allocator for mbediso_load */
+struct mbediso_allocator
+{
+    void* (*alloc)(void* userdata, size_t size);
+    void (*free)(void* userdata, void* ptr);
+    void* userdata;
+};
+
+/* destination buffer for mbediso_freadv */
+struct mbediso_iovec
+{
+    void* base;
+    size_t length;
+};
+
+/* async read priorities: prefetches are served once no foreground reads are waiting (or after waiting too long) */
+#define MBEDISO_PRIORITY_FOREGROUND 0
+#define MBEDISO_PRIORITY_PREFETCH 1
+#define MBEDISO_PRIORITY_COUNT 2
+
+/* called from a worker thread when an mbediso_read_async request finishes */
+typedef void (*mbediso_read_callback)(void* userdata, void* buffer, size_t bytes_read);
+
+/* a finished mbediso_read_async request without a callback, from mbediso_poll_completions */
+struct mbediso_completion
+{
+    void* userdata;
+    void* buffer;
+    size_t bytes_read;
+};
+
+/* read-only view of part of a file, from mbediso_fmap */
+struct mbediso_view
+{
+    const uint8_t* data;
+    size_t length;
+
+    /* what backs the view: a memory mapping, a pinned IO block, or a heap buffer */
+    struct mbediso_fs* fs;
+    void* map_base;
+    size_t map_length;
+    struct mbediso_io* pinned_io;
+    void* buffer;
+};
+
+/* file handles hold no IO resources: each read borrows an IO from the filesystem's pool */
 struct mbediso_file
 {
-    struct mbediso_io* io;
     struct mbediso_fs* fs;
     uint32_t start;
     uint32_t end;
@@ -39,8 +87,61 @@ struct mbediso_file
 
 struct mbediso_file* mbediso_fopen(struct mbediso_fs* fs, const char* pathname);
 
+/* returns a stable ID for the file at pathname (valid for any mbediso_fs opened on the same archive), or MBEDISO_INVALID_ID if it is not a file */
+uint64_t mbediso_lookup_id(struct mbediso_fs* fs, const char* pathname);
+
+/* opens a file by ID without any path lookup */
+struct mbediso_file* mbediso_fopen_id(struct mbediso_fs* fs, uint64_t id);
+
+/**
+ * \brief loads an entire file into a single new buffer
+ *
+ * Whole blocks are decompressed straight into the buffer, without an open file handle or intermediate copies.
+ *
+ * \param size receives the file's size
+ * \param allocator used to allocate the buffer (and free it on failure); if NULL, malloc and free are used
+ *
+ * \returns the file's contents (to be freed by the caller), or NULL on failure
+ **/
+void* mbediso_load(struct mbediso_fs* fs, const char* pathname, size_t* size, const struct mbediso_allocator* allocator);
+
 size_t mbediso_fread(struct mbediso_file* file, void* ptr, size_t size, size_t maxnum);
 
+/* fills each buffer in iov in turn from the file position (advancing it), using a single IO for the whole call. Returns total bytes read. */
+size_t mbediso_freadv(struct mbediso_file* file, const struct mbediso_iovec* iov, int iovcnt);
+
+/* reads up to bytes from offset without using or changing the file position; safe to call on a shared handle from several threads. Returns bytes read. */
+size_t mbediso_pread(struct mbediso_file* file, void* ptr, size_t bytes, int64_t offset);
+
+/**
+ * \brief queues a read of up to length bytes at offset within the file, performed by the filesystem's worker threads
+ *
+ * Pending reads are served in archive order rather than arrival order, sweeping across the archive like an elevator, and reads that continue one another are performed together. When the read finishes, callback is called from a worker thread; if callback is NULL, a completion is posted for mbediso_poll_completions instead. The file may be closed immediately, but buffer must stay valid until the read finishes. Without thread support, the read is performed before this returns.
+ *
+ * \returns 0 if the read was queued, or -1 on failure
+ **/
+int mbediso_read_async(struct mbediso_file* file, int64_t offset, void* buffer, size_t length, mbediso_read_callback callback, void* userdata);
+
+/* like mbediso_read_async, with one of the MBEDISO_PRIORITY values (mbediso_read_async uses MBEDISO_PRIORITY_FOREGROUND) */
+int mbediso_read_async_priority(struct mbediso_file* file, int64_t offset, void* buffer, size_t length, int priority, mbediso_read_callback callback, void* userdata);
+
+/* takes up to max_completions finished reads from the completion queue, returning how many were taken */
+int mbediso_poll_completions(struct mbediso_fs* fs, struct mbediso_completion* out, int max_completions);
+
+/* returns an eventfd which is readable while completions are waiting (suitable for poll or epoll), or -1 if unsupported or if no async read has been queued yet */
+int mbediso_completion_fd(struct mbediso_fs* fs);
+
+/**
+ * \brief returns a read-only view of length bytes at offset within the file, valid until passed to mbediso_funmap
+ *
+ * For uncompressed archives the view is a window into a memory mapping of the archive (where available). For LZ4 archives, a range within one block pins the decompressed block (holding one IO until unmapped), and other ranges are decompressed into a new buffer.
+ *
+ * \returns the view, or NULL if the range is not within the file or on failure
+ **/
+const struct mbediso_view* mbediso_fmap(struct mbediso_file* file, int64_t offset, size_t length);
+
+void mbediso_funmap(const struct mbediso_view* view);
+
 int64_t mbediso_fseek(struct mbediso_file* file, int64_t offset, int whence);
 
 int64_t mbediso_fsize(struct mbediso_file* file);
@@ -48,3 +149,5 @@ int64_t mbediso_fsize(struct mbediso_file* file);
 void mbediso_fclose(struct mbediso_file* file);
 
 struct mbediso_fs* mbediso_file_fs(struct mbediso_file* file);
+
+uint64_t mbediso_file_id(struct mbediso_file* file);
@@ -19,10 +19,33 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <stdbool.h>
 
 struct mbediso_fs;
 
+/* work done by reads through an fs, for tuning archive settings */
+struct mbediso_stats
+{
+    uint64_t bytes_read; /* bytes read from the archive file */
+    uint64_t blocks_decoded; /* LZ4 blocks decompressed */
+};
+
 struct mbediso_fs* mbediso_openfs_file(const char* name, bool full_scan);
 int mbediso_scanfs(struct mbediso_fs* fs);
 void mbediso_closefs(struct mbediso_fs* fs);
+
+/* starts recording which archive sectors are read (by IOs reserved from now on), for mbediso_save_profile */
+int mbediso_record_profile(struct mbediso_fs* fs);
+
+/* writes the sectors recorded so far, in first-access order, to a compact profile file */
+int mbediso_save_profile(struct mbediso_fs* fs, const char* filename);
+
+/* fills stats with the work done by reads that have finished since the fs was opened (or the stats were last reset) */
+void mbediso_get_stats(struct mbediso_fs* fs, struct mbediso_stats* stats, bool reset);
+
+/* sets the most compressed data an LZ4 archive read fetches at once (at least one block; 0 for the default); applies to reads started afterwards */
+void mbediso_set_read_ahead(struct mbediso_fs* fs, uint32_t bytes);
+
+/* prefetches the sectors listed in a profile file in archive order, as low-priority async work (synchronously without thread support) */
+int mbediso_replay_profile(struct mbediso_fs* fs, const char* filename);
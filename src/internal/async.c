@@ -0,0 +1,355 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#ifdef MBEDISO_HAVE_EVENTFD
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "internal/async.h"
+#include "internal/fs.h"
+#include "internal/io.h"
+
+#ifndef MBEDISO_ASYNC_WORKERS
+#define MBEDISO_ASYNC_WORKERS 2
+#endif
+
+/* requests waiting longer than this many dispatches are served next, whatever their priority or position */
+static const uint32_t c_async_max_wait = 64;
+
+/* most requests performed together in one dispatch */
+#define MBEDISO_ASYNC_MAX_BATCH 16
+
+static void s_mbediso_async_complete(struct mbediso_async* async, struct mbediso_async_request* request)
+{
+    // prefetches have nothing to report
+    if(request->callback || !request->buffer)
+    {
+        if(request->callback)
+            request->callback(request->userdata, request->buffer, request->bytes_read);
+
+        free(request);
+        return;
+    }
+
+    // post to the completion queue
+    request->next = NULL;
+
+    mbediso_mutex_lock(async->mutex);
+
+    if(async->completion_tail)
+        async->completion_tail->next = request;
+    else
+        async->completion_head = request;
+
+    async->completion_tail = request;
+
+#ifdef MBEDISO_HAVE_EVENTFD
+    if(async->event_fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t ret = write(async->event_fd, &one, sizeof(one));
+        (void)ret;
+    }
+#endif
+
+    mbediso_mutex_unlock(async->mutex);
+}
+
+/* performs a batch of requests in order using a single IO, so that each continues from the block cached by the last */
+static void s_mbediso_async_perform(struct mbediso_async* async, struct mbediso_async_request** batch, int count)
+{
+    struct mbediso_io* io = mbediso_fs_reserve_io(async->fs);
+
+    for(int i = 0; i < count; i++)
+    {
+        batch[i]->bytes_read = 0;
+
+        if(!io)
+            continue;
+
+        if(batch[i]->buffer)
+            batch[i]->bytes_read = mbediso_io_read_direct(io, batch[i]->buffer, batch[i]->offset, batch[i]->length);
+        else
+            mbediso_io_prefetch(io, batch[i]->offset, batch[i]->length);
+    }
+
+    mbediso_fs_release_io(async->fs, io);
+
+    for(int i = 0; i < count; i++)
+        s_mbediso_async_complete(async, batch[i]);
+}
+
+static bool s_mbediso_async_pending(const struct mbediso_async* async)
+{
+    for(int p = 0; p < MBEDISO_PRIORITY_COUNT; p++)
+    {
+        if(async->requests[p])
+            return true;
+    }
+
+    return false;
+}
+
+/* returns the link to the request that should be dispatched next; requires a pending request */
+static struct mbediso_async_request** s_mbediso_async_pick(struct mbediso_async* async)
+{
+    // starvation protection: serve the longest-waiting request once it has waited too long
+    struct mbediso_async_request** oldest = NULL;
+    uint32_t oldest_wait = 0;
+
+    for(int p = 0; p < MBEDISO_PRIORITY_COUNT; p++)
+    {
+        for(struct mbediso_async_request** link = &async->requests[p]; *link; link = &(*link)->next)
+        {
+            uint32_t wait = async->dispatch_count - (*link)->submit_tick;
+            if(!oldest || wait > oldest_wait)
+            {
+                oldest = link;
+                oldest_wait = wait;
+            }
+        }
+    }
+
+    if(oldest_wait > c_async_max_wait)
+        return oldest;
+
+    // elevator over the highest pending priority: continue upwards from the head, then wrap around to the start
+    for(int p = 0; p < MBEDISO_PRIORITY_COUNT; p++)
+    {
+        if(!async->requests[p])
+            continue;
+
+        struct mbediso_async_request** link = &async->requests[p];
+        while(*link && (*link)->offset < async->head_position)
+            link = &(*link)->next;
+
+        if(!*link)
+            link = &async->requests[p];
+
+        return link;
+    }
+
+    return oldest;
+}
+
+/* unlinks the next request, along with any following requests that continue it, returning the batch size; requires a pending request */
+static int s_mbediso_async_take_batch(struct mbediso_async* async, struct mbediso_async_request** batch)
+{
+    struct mbediso_async_request** link = s_mbediso_async_pick(async);
+
+    uint64_t batch_end = (*link)->offset;
+    int count = 0;
+
+    // the list is sorted, so continuing requests follow the picked one
+    while(count < MBEDISO_ASYNC_MAX_BATCH && *link && (*link)->offset <= batch_end)
+    {
+        struct mbediso_async_request* request = *link;
+        *link = request->next;
+
+        if(request->offset + request->length > batch_end)
+            batch_end = request->offset + request->length;
+
+        batch[count++] = request;
+    }
+
+    async->head_position = batch_end;
+    async->dispatch_count += count;
+
+    return count;
+}
+
+static int s_mbediso_async_worker(void* data)
+{
+    struct mbediso_async* async = (struct mbediso_async*)data;
+    struct mbediso_async_request* batch[MBEDISO_ASYNC_MAX_BATCH];
+
+    mbediso_mutex_lock(async->mutex);
+
+    while(true)
+    {
+        while(!s_mbediso_async_pending(async) && !async->quit)
+            mbediso_cond_wait(async->request_cond, async->mutex);
+
+        // only quit once all requests are done
+        if(!s_mbediso_async_pending(async))
+            break;
+
+        int count = s_mbediso_async_take_batch(async, batch);
+
+        mbediso_mutex_unlock(async->mutex);
+
+        s_mbediso_async_perform(async, batch, count);
+
+        mbediso_mutex_lock(async->mutex);
+    }
+
+    mbediso_mutex_unlock(async->mutex);
+
+    return 0;
+}
+
+struct mbediso_async* mbediso_async_alloc(struct mbediso_fs* fs)
+{
+    struct mbediso_async* async = malloc(sizeof(struct mbediso_async));
+    if(!async)
+        return NULL;
+
+    async->fs = fs;
+    for(int p = 0; p < MBEDISO_PRIORITY_COUNT; p++)
+        async->requests[p] = NULL;
+
+    async->head_position = 0;
+    async->dispatch_count = 0;
+    async->completion_head = NULL;
+    async->completion_tail = NULL;
+    async->worker_count = 0;
+    async->event_fd = -1;
+    async->quit = false;
+
+    async->mutex = mbediso_mutex_alloc();
+    async->request_cond = mbediso_cond_alloc();
+    async->workers = malloc(MBEDISO_ASYNC_WORKERS * sizeof(mbediso_thread_t));
+
+    if(!async->mutex || !async->request_cond || !async->workers)
+    {
+        mbediso_async_free(async);
+        return NULL;
+    }
+
+#ifdef MBEDISO_HAVE_EVENTFD
+    async->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+    // without thread support, requests are performed synchronously
+    for(int i = 0; i < MBEDISO_ASYNC_WORKERS; i++)
+    {
+        mbediso_thread_t worker = mbediso_thread_create(s_mbediso_async_worker, async);
+        if(!worker)
+            break;
+
+        async->workers[async->worker_count++] = worker;
+    }
+
+    return async;
+}
+
+void mbediso_async_free(struct mbediso_async* async)
+{
+    if(!async)
+        return;
+
+    if(async->mutex)
+    {
+        mbediso_mutex_lock(async->mutex);
+        async->quit = true;
+        mbediso_cond_broadcast(async->request_cond);
+        mbediso_mutex_unlock(async->mutex);
+    }
+
+    for(int i = 0; i < async->worker_count; i++)
+        mbediso_thread_join(async->workers[i]);
+
+    // drop any unpolled completions
+    while(async->completion_head)
+    {
+        struct mbediso_async_request* next = async->completion_head->next;
+        free(async->completion_head);
+        async->completion_head = next;
+    }
+
+#ifdef MBEDISO_HAVE_EVENTFD
+    if(async->event_fd >= 0)
+        close(async->event_fd);
+#endif
+
+    if(async->request_cond)
+        mbediso_cond_free(async->request_cond);
+
+    if(async->mutex)
+        mbediso_mutex_free(async->mutex);
+
+    free(async->workers);
+    free(async);
+}
+
+void mbediso_async_submit(struct mbediso_async* async, struct mbediso_async_request* request)
+{
+    if(async->worker_count == 0)
+    {
+        s_mbediso_async_perform(async, &request, 1);
+        return;
+    }
+
+    mbediso_mutex_lock(async->mutex);
+
+    request->submit_tick = async->dispatch_count;
+
+    // insert in offset order (after any requests at the same offset)
+    struct mbediso_async_request** link = &async->requests[request->priority];
+    while(*link && (*link)->offset <= request->offset)
+        link = &(*link)->next;
+
+    request->next = *link;
+    *link = request;
+
+    mbediso_cond_signal(async->request_cond);
+    mbediso_mutex_unlock(async->mutex);
+}
+
+int mbediso_async_poll(struct mbediso_async* async, struct mbediso_completion* out, int max_completions)
+{
+    int count = 0;
+
+    mbediso_mutex_lock(async->mutex);
+
+    while(count < max_completions && async->completion_head)
+    {
+        struct mbediso_async_request* request = async->completion_head;
+        async->completion_head = request->next;
+
+        out[count].userdata = request->userdata;
+        out[count].buffer = request->buffer;
+        out[count].bytes_read = request->bytes_read;
+        count++;
+
+        free(request);
+    }
+
+    if(!async->completion_head)
+    {
+        async->completion_tail = NULL;
+
+#ifdef MBEDISO_HAVE_EVENTFD
+        // reset the eventfd once every completion has been taken
+        if(async->event_fd >= 0)
+        {
+            uint64_t value;
+            ssize_t ret = read(async->event_fd, &value, sizeof(value));
+            (void)ret;
+        }
+#endif
+    }
+
+    mbediso_mutex_unlock(async->mutex);
+
+    return count;
+}
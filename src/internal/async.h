@@ -0,0 +1,86 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mbediso/file.h"
+#include "internal/mutex/thread.h"
+
+struct mbediso_fs;
+
+/* a queued async read, which becomes a completion once done; a request without a buffer only prefetches its range */
+struct mbediso_async_request
+{
+    struct mbediso_async_request* next;
+
+    uint64_t offset;
+    size_t length;
+    void* buffer;
+
+    int priority;
+    /* value of dispatch_count when the request was queued */
+    uint32_t submit_tick;
+
+    mbediso_read_callback callback;
+    void* userdata;
+
+    size_t bytes_read;
+};
+
+/* worker pool serving the async reads of an fs */
+struct mbediso_async
+{
+    struct mbediso_fs* fs;
+
+    mbediso_mutex_t mutex;
+    mbediso_cond_t request_cond;
+
+    /* pending requests for each priority, sorted by archive offset */
+    struct mbediso_async_request* requests[MBEDISO_PRIORITY_COUNT];
+
+    /* archive offset following the last dispatched request, where the elevator continues */
+    uint64_t head_position;
+    uint32_t dispatch_count;
+
+    /* finished requests without a callback, waiting to be polled */
+    struct mbediso_async_request* completion_head;
+    struct mbediso_async_request* completion_tail;
+
+    mbediso_thread_t* workers;
+    int worker_count;
+
+    /* eventfd signaled when completions are posted, or -1 */
+    int event_fd;
+
+    bool quit;
+};
+
+struct mbediso_async* mbediso_async_alloc(struct mbediso_fs* fs);
+
+/* finishes all pending requests, then stops the workers */
+void mbediso_async_free(struct mbediso_async* async);
+
+/* takes ownership of request (with priority set); performs it synchronously if there are no workers */
+void mbediso_async_submit(struct mbediso_async* async, struct mbediso_async_request* request);
+
+int mbediso_async_poll(struct mbediso_async* async, struct mbediso_completion* out, int max_completions);
@@ -31,6 +31,24 @@
 #include "internal/io.h"
 #include "internal/read.h"
 
+/* directories with fewer entries than this are searched without keys */
+static const uint32_t c_key_min_entries = 64;
+
+/* directories with at least this many entries also get a tree of separator keys, so that a search touches a few cache lines per level */
+static const uint32_t c_key_tree_min_entries = 1024;
+
+/* number of keys per node of the separator tree (two cache lines) */
+#define MBEDISO_KEY_TREE_FANOUT 16
+#define MBEDISO_KEY_TREE_MAX_LEVELS 8
+
+/* every Nth entry stores its full name, bounding the cost of reconstructing any name; set by the build system */
+#ifndef MBEDISO_STRING_RESTART_INTERVAL
+#define MBEDISO_STRING_RESTART_INTERVAL 16
+#endif
+
+/* directories with fewer entries than this do not get a name filter */
+static const uint32_t c_filter_min_entries = 16;
+
 bool mbediso_directory_ctor(struct mbediso_directory* dir)
 {
     if(!dir)
@@ -47,6 +65,13 @@ bool mbediso_directory_ctor(struct mbediso_directory* dir)
     dir->entry_count = 0;
     dir->entry_capacity = 0;
 
+    dir->keys = NULL;
+    dir->key_offset = 0;
+
+    dir->key_tree = NULL;
+
+    mbediso_filter_ctor(&dir->filter);
+
     dir->utf8_sorted = true;
 
     return true;
@@ -59,6 +84,9 @@ void mbediso_directory_dtor(struct mbediso_directory* dir)
 
     free(dir->stringtable);
     free(dir->entries);
+    free(dir->keys);
+    free(dir->key_tree);
+    mbediso_filter_dtor(&dir->filter);
 }
 
 int mbediso_directory_push(struct mbediso_directory* dir, const struct mbediso_raw_entry* raw_entry)
@@ -201,16 +229,223 @@ static bool mbediso_directory_safe_lookup(const struct mbediso_directory* dir, c
 }
 #endif
 
+static uint64_t s_directory_key(const uint8_t* name, uint32_t length)
+{
+    // big-endian packing of the first 8 bytes (zero-padded) sorts the same way as the names themselves
+    uint64_t key = 0;
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        key <<= 8;
+        if(i < length)
+            key |= name[i];
+    }
+
+    return key;
+}
+
+/* returns the first index whose key is not less than key */
+static uint32_t s_directory_key_lower_bound(const uint64_t* keys, uint32_t count, uint64_t key)
+{
+    if(count == 0)
+        return 0;
+
+    // branchless form: the loop trip count only depends on count, and the select compiles to a conditional move
+    const uint64_t* base = keys;
+    uint32_t n = count;
+
+    while(n > 1)
+    {
+        uint32_t half = n / 2;
+        base = (base[half] < key) ? base + half : base;
+        n -= half;
+    }
+
+    return (uint32_t)(base - keys) + (*base < key);
+}
+
+/* fills sizes with the number of keys in each level of the separator tree, starting with the keys themselves, and returns the number of separator levels */
+static uint32_t s_directory_key_tree_sizes(uint32_t entry_count, uint32_t* sizes)
+{
+    uint32_t levels = 0;
+    sizes[0] = entry_count;
+
+    while(sizes[levels] > MBEDISO_KEY_TREE_FANOUT && levels + 1 < MBEDISO_KEY_TREE_MAX_LEVELS)
+    {
+        sizes[levels + 1] = (sizes[levels] + (MBEDISO_KEY_TREE_FANOUT - 1)) / MBEDISO_KEY_TREE_FANOUT;
+        levels++;
+    }
+
+    return levels;
+}
+
+/* returns the first index whose key is not less than key, using the separator tree if present */
+static uint32_t s_mbediso_directory_key_lower_bound(const struct mbediso_directory* dir, uint64_t key)
+{
+    if(!dir->key_tree)
+        return s_directory_key_lower_bound(dir->keys, dir->entry_count, key);
+
+    uint32_t sizes[MBEDISO_KEY_TREE_MAX_LEVELS];
+    uint32_t levels = s_directory_key_tree_sizes(dir->entry_count, sizes);
+
+    // the top level is searched in full
+    const uint64_t* level_keys = dir->key_tree;
+    uint32_t lo = 0;
+    uint32_t hi = sizes[levels];
+
+    for(uint32_t level = levels; ; level--)
+    {
+        // count the keys below the target within the node; this is a fixed-width scan of two cache lines
+        uint32_t found = lo;
+        for(uint32_t i = lo; i < hi; i++)
+            found += (level_keys[i] < key);
+
+        if(level == 0)
+            return found;
+
+        // descend into the node below the last separator that is less than key
+        if(found == 0)
+            hi = 0;
+        else
+        {
+            lo = (found - 1) * MBEDISO_KEY_TREE_FANOUT;
+            hi = found * MBEDISO_KEY_TREE_FANOUT;
+            if(hi > sizes[level - 1])
+                hi = sizes[level - 1];
+        }
+
+        if(level == 1)
+            level_keys = dir->keys;
+        else
+            level_keys += sizes[level];
+    }
+}
+
+static void s_mbediso_directory_build_key_tree(struct mbediso_directory* dir)
+{
+    if(!dir->keys || dir->entry_count < c_key_tree_min_entries)
+        return;
+
+    uint32_t sizes[MBEDISO_KEY_TREE_MAX_LEVELS];
+    uint32_t levels = s_directory_key_tree_sizes(dir->entry_count, sizes);
+
+    size_t total = 0;
+    for(uint32_t level = 1; level <= levels; level++)
+        total += sizes[level];
+
+    dir->key_tree = malloc(total * sizeof(uint64_t));
+    if(!dir->key_tree)
+        return;
+
+    // fill levels from the bottom up; the top level is stored first
+    const uint64_t* below = dir->keys;
+    size_t level_offset = total;
+
+    for(uint32_t level = 1; level <= levels; level++)
+    {
+        level_offset -= sizes[level];
+        uint64_t* cur = dir->key_tree + level_offset;
+
+        for(uint32_t i = 0; i < sizes[level]; i++)
+            cur[i] = below[i * MBEDISO_KEY_TREE_FANOUT];
+
+        below = cur;
+    }
+}
+
+/* must be called while the stringtable still holds a full name for each entry (before compaction) */
+static void s_mbediso_directory_build_keys(struct mbediso_directory* dir)
+{
+    if(dir->entry_count < c_key_min_entries || !dir->utf8_sorted)
+        return;
+
+    dir->keys = malloc(dir->entry_count * sizeof(uint64_t));
+    if(!dir->keys)
+        return;
+
+    // the directory is sorted, so the prefix shared by the first and last names is shared by all of them
+    const struct mbediso_string_diff* first = &dir->entries[0].name_frag;
+    const struct mbediso_string_diff* last = &dir->entries[dir->entry_count - 1].name_frag;
+
+    uint32_t common = 0;
+    while(common < first->subst_end && common < last->subst_end
+        && dir->stringtable[first->subst_table_offset + common] == dir->stringtable[last->subst_table_offset + common])
+    {
+        common++;
+    }
+
+    dir->key_offset = common;
+
+    for(uint32_t i = 0; i < dir->entry_count; i++)
+    {
+        const struct mbediso_string_diff* frag = &dir->entries[i].name_frag;
+        dir->keys[i] = s_directory_key(dir->stringtable + frag->subst_table_offset + common, frag->subst_end - common);
+    }
+
+    s_mbediso_directory_build_key_tree(dir);
+}
+
+/* must be called while the stringtable still holds a full name for each entry (before compaction) */
+static void s_mbediso_directory_build_filter(struct mbediso_directory* dir)
+{
+    if(dir->entry_count < c_filter_min_entries)
+        return;
+
+    if(!mbediso_filter_alloc(&dir->filter, dir->entry_count))
+        return;
+
+    for(uint32_t i = 0; i < dir->entry_count; i++)
+    {
+        const struct mbediso_string_diff* frag = &dir->entries[i].name_frag;
+        mbediso_filter_add(&dir->filter, mbediso_util_hash(MBEDISO_UTIL_HASH_INIT, dir->stringtable + frag->subst_table_offset, frag->subst_end));
+    }
+}
+
 bool mbediso_directory_lookup(const struct mbediso_directory* dir, const char* _name, uint32_t name_length, struct mbediso_location** out)
 {
     const uint8_t* name = (const uint8_t*)_name;
 
+    // reject names that are definitely missing
+    if(dir->filter.blocks && !mbediso_filter_may_contain(&dir->filter, mbediso_util_hash(MBEDISO_UTIL_HASH_INIT, name, name_length)))
+        return false;
+
     // perform binary search on directory's entries
     uint32_t begin_ge_end = 0;
     uint32_t begin = 0;
     uint32_t end = dir->entry_count;
     uint32_t end_le_end = 0;
 
+    // narrow the search to the entries whose keys match the name
+    if(dir->keys)
+    {
+        // the first entry is always stored in full, so its name holds the common prefix
+        const uint8_t* common = dir->stringtable + dir->entries[0].name_frag.subst_table_offset;
+
+        if(name_length < dir->key_offset || memcmp(name, common, dir->key_offset) != 0)
+            return false;
+
+        uint32_t key_length = name_length - dir->key_offset;
+        uint64_t key = s_directory_key(name + dir->key_offset, key_length);
+
+        begin = s_mbediso_directory_key_lower_bound(dir, key);
+        if(begin == dir->entry_count || dir->keys[begin] != key)
+            return false;
+
+        // names are never zero-padded, so a name that fits entirely in the key is an exact match
+        if(key_length < 8)
+        {
+            *out = &dir->entries[begin].l;
+            return true;
+        }
+
+        end = dir->entry_count;
+        if(key != UINT64_MAX)
+            end = s_mbediso_directory_key_lower_bound(dir, key + 1);
+
+        // every entry left in the range matches the name up to the end of the key
+        begin_ge_end = dir->key_offset + 8;
+        end_le_end = dir->key_offset + 8;
+    }
+
     while(begin < end)
     {
         uint32_t mid = begin + (end - begin) / 2;
@@ -313,12 +548,96 @@ bool mbediso_directory_lookup(const struct mbediso_directory* dir, const char* _
     return false;
 }
 
+int mbediso_directory_get_name(const struct mbediso_directory* dir, uint32_t index, struct mbediso_name* name)
+{
+    if(index >= dir->entry_count)
+        return -1;
+
+    if(mbediso_string_diff_reconstruct(name->buffer, sizeof(name->buffer), dir->stringtable, dir->entries, dir->entry_count, sizeof(struct mbediso_dir_entry), index))
+        return -1;
+
+    return strlen((const char*)name->buffer);
+}
+
+/* compares only the first prefix_length bytes of the entry's name (a name that starts with prefix compares equal) */
+static int s_mbediso_directory_prefix_cmp(const struct mbediso_directory* dir, uint32_t index, const uint8_t* prefix, uint32_t prefix_length)
+{
+    struct mbediso_name name;
+
+    int name_length = mbediso_directory_get_name(dir, index, &name);
+    if(name_length < 0)
+        return 1;
+
+    uint32_t cmp_length = ((uint32_t)name_length < prefix_length) ? (uint32_t)name_length : prefix_length;
+
+    int ret = memcmp(name.buffer, prefix, cmp_length);
+    if(ret == 0 && (uint32_t)name_length < prefix_length)
+        ret = -1;
+
+    return ret;
+}
+
+void mbediso_directory_prefix_range(const struct mbediso_directory* dir, const char* _prefix, uint32_t prefix_length, uint32_t* begin, uint32_t* end)
+{
+    const uint8_t* prefix = (const uint8_t*)_prefix;
+
+    // the entries are sorted, so the names starting with prefix are contiguous; find the first one
+    uint32_t lo = 0;
+    uint32_t hi = dir->entry_count;
+
+    while(lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if(s_mbediso_directory_prefix_cmp(dir, mid, prefix, prefix_length) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *begin = lo;
+
+    // then the first one past them
+    hi = dir->entry_count;
+
+    while(lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if(s_mbediso_directory_prefix_cmp(dir, mid, prefix, prefix_length) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *end = lo;
+}
+
+void mbediso_directory_next_name(const struct mbediso_directory* dir, uint32_t index, struct mbediso_name* name, uint32_t* name_length)
+{
+    const struct mbediso_string_diff* diff = &dir->entries[index].name_frag;
+
+    // each entry only stores the bytes that differ from the previous entry
+    const uint8_t* diff_str = dir->stringtable + diff->subst_table_offset;
+    for(unsigned i = diff->subst_begin; i < diff->subst_end; ++i)
+        name->buffer[i] = *(diff_str++);
+
+    if(diff->clip_end)
+    {
+        name->buffer[diff->subst_end] = '\0';
+        *name_length = diff->subst_end;
+    }
+}
+
 static int s_mbediso_directory_finish(struct mbediso_directory* dir)
 {
     if(!dir->utf8_sorted)
         s_directory_sort_PRECOMPACT(dir);
 
-    int ret = mbediso_string_diff_compact(&dir->stringtable, &dir->stringtable_size, dir->entries, dir->entry_count, sizeof(struct mbediso_dir_entry));
+    s_mbediso_directory_build_keys(dir);
+    s_mbediso_directory_build_filter(dir);
+
+    int ret = mbediso_string_diff_compact(&dir->stringtable, &dir->stringtable_size, dir->entries, dir->entry_count, sizeof(struct mbediso_dir_entry), MBEDISO_STRING_RESTART_INTERVAL);
     if(ret)
         return ret;
 
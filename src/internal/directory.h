@@ -23,6 +23,7 @@
 #include <stdbool.h>
 
 #include "internal/string_diff.h"
+#include "internal/filter.h"
 
 struct mbediso_io;
 
@@ -41,6 +42,9 @@ struct mbediso_location
     bool directory;
 };
 
+/* stable 64-bit IDs for file locations (sector in the high half, length in the low half) */
+#define MBEDISO_LOCATION_ID(l) (((uint64_t)(l)->sector << 32) | (uint64_t)(l)->length)
+
 /* struct for a raw directory entry */
 struct mbediso_raw_entry
 {
@@ -67,6 +71,16 @@ struct mbediso_directory
     uint32_t entry_count;
     uint32_t entry_capacity;
 
+    /* order-preserving keys made of the 8 name bytes following the prefix shared by all entries; NULL for small directories */
+    uint64_t* keys;
+    uint32_t key_offset;
+
+    /* separator levels over keys for very large directories, top level first (each level holds every 16th key of the level below); NULL otherwise */
+    uint64_t* key_tree;
+
+    /* filter of name hashes, used to reject missing names without a search; unused for small directories */
+    struct mbediso_filter filter;
+
     /* tracks whether the directory is utf8-sorted */
     bool utf8_sorted;
 };
@@ -77,6 +91,15 @@ void mbediso_directory_dtor(struct mbediso_directory* dir);
 int mbediso_directory_push(struct mbediso_directory* dir, const struct mbediso_raw_entry* entry);
 bool mbediso_directory_lookup(const struct mbediso_directory* dir, const char* name, uint32_t name_length, struct mbediso_location** out);
 
+/* fill name with the full name of entry index, returning its length, or -1 on failure */
+int mbediso_directory_get_name(const struct mbediso_directory* dir, uint32_t index, struct mbediso_name* name);
+
+/* find the range of entries [*begin, *end) whose names start with prefix */
+void mbediso_directory_prefix_range(const struct mbediso_directory* dir, const char* prefix, uint32_t prefix_length, uint32_t* begin, uint32_t* end);
+
+/* update name (of length *name_length) from the name of entry index - 1 to the name of entry index; name may hold anything for index 0 */
+void mbediso_directory_next_name(const struct mbediso_directory* dir, uint32_t index, struct mbediso_name* name, uint32_t* name_length);
+
 /* load a directory's entries from the filesystem and prepare the directory for use */
 int mbediso_directory_load(struct mbediso_directory* dir, struct mbediso_io* io, uint32_t sector, uint32_t length);
 
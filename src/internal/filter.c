@@ -0,0 +1,113 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal/filter.h"
+#include "internal/util.h"
+
+/* each block is 512 bits (one cache line) */
+#define MBEDISO_FILTER_BLOCK_WORDS 8
+
+/* roughly 1% false positives at 10 bits per item with 4 probes */
+static const uint32_t c_filter_bits_per_item = 10;
+static const uint32_t c_filter_probes = 4;
+
+static uint64_t s_filter_mix(uint64_t hash)
+{
+    // 64-bit finalizer from MurmurHash3, so that all hash bits affect the probes
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+void mbediso_filter_ctor(struct mbediso_filter* filter)
+{
+    filter->blocks = NULL;
+    filter->block_mask = 0;
+}
+
+void mbediso_filter_dtor(struct mbediso_filter* filter)
+{
+    free(filter->blocks);
+    filter->blocks = NULL;
+    filter->block_mask = 0;
+}
+
+bool mbediso_filter_alloc(struct mbediso_filter* filter, uint32_t item_count)
+{
+    mbediso_filter_dtor(filter);
+
+    size_t want_blocks = ((size_t)item_count * c_filter_bits_per_item + 511) / 512;
+    size_t block_count = mbediso_util_first_pow2(want_blocks);
+
+    // mbediso_util_first_pow2 gives up above 2^24
+    if(block_count & (block_count - 1))
+        return false;
+
+    filter->blocks = calloc(block_count * MBEDISO_FILTER_BLOCK_WORDS, sizeof(uint64_t));
+    if(!filter->blocks)
+        return false;
+
+    filter->block_mask = block_count - 1;
+
+    return true;
+}
+
+void mbediso_filter_add(struct mbediso_filter* filter, uint64_t hash)
+{
+    if(!filter->blocks)
+        return;
+
+    hash = s_filter_mix(hash);
+
+    uint64_t* block = filter->blocks + (size_t)((hash >> 36) & filter->block_mask) * MBEDISO_FILTER_BLOCK_WORDS;
+
+    for(uint32_t i = 0; i < c_filter_probes; i++)
+    {
+        uint32_t bit = (hash >> (i * 9)) & 511;
+        block[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+}
+
+bool mbediso_filter_may_contain(const struct mbediso_filter* filter, uint64_t hash)
+{
+    if(!filter->blocks)
+        return true;
+
+    hash = s_filter_mix(hash);
+
+    const uint64_t* block = filter->blocks + (size_t)((hash >> 36) & filter->block_mask) * MBEDISO_FILTER_BLOCK_WORDS;
+
+    for(uint32_t i = 0; i < c_filter_probes; i++)
+    {
+        uint32_t bit = (hash >> (i * 9)) & 511;
+        if(!(block[bit / 64] & ((uint64_t)1 << (bit % 64))))
+            return false;
+    }
+
+    return true;
+}
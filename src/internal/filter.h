@@ -0,0 +1,42 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* blocked Bloom filter over 64-bit hashes: every item sets a few bits within a single cache line */
+struct mbediso_filter
+{
+    /* NULL if the filter is not in use; a filter that is not in use may contain anything */
+    uint64_t* blocks;
+    uint32_t block_mask;
+};
+
+void mbediso_filter_ctor(struct mbediso_filter* filter);
+void mbediso_filter_dtor(struct mbediso_filter* filter);
+
+/* allocates an empty filter sized for item_count items */
+bool mbediso_filter_alloc(struct mbediso_filter* filter, uint32_t item_count);
+
+void mbediso_filter_add(struct mbediso_filter* filter, uint64_t hash);
+
+/* returns false only if the hash was definitely never added */
+bool mbediso_filter_may_contain(const struct mbediso_filter* filter, uint64_t hash);
@@ -28,6 +28,8 @@
 
 #include "internal/util.h"
 #include "internal/fs.h"
+#include "internal/async.h"
+#include "internal/profile.h"
 #include "internal/io.h"
 #include "internal/lz4_header.h"
 #include "internal/mutex/mutex.h"
@@ -50,12 +52,21 @@ bool mbediso_fs_ctor(struct mbediso_fs* fs)
 
     fs->fully_scanned = false;
 
+    mbediso_filter_ctor(&fs->path_filter);
+
     /* tracks the allocated and used IO instances */
     fs->io_pool = NULL;
     fs->io_pool_used = 0;
     fs->io_pool_size = 0;
     fs->io_pool_capacity = 0;
 
+    fs->async = NULL;
+    fs->profile = NULL;
+
+    fs->stats.bytes_read = 0;
+    fs->stats.blocks_decoded = 0;
+    fs->read_ahead = 0;
+
     /* allocate mutexes */
     fs->io_pool_mutex = mbediso_mutex_alloc();
     if(!fs->io_pool_mutex)
@@ -77,6 +88,17 @@ void mbediso_fs_dtor(struct mbediso_fs* fs)
     if(!fs)
         return;
 
+    // finish any async reads while the io pool still exists
+    mbediso_async_free(fs->async);
+    fs->async = NULL;
+
+    if(fs->profile)
+    {
+        mbediso_profile_dtor(fs->profile);
+        free(fs->profile);
+        fs->profile = NULL;
+    }
+
     if(fs->directories)
     {
         for(uint32_t i = 0; i < fs->directory_count; i++)
@@ -86,6 +108,8 @@ void mbediso_fs_dtor(struct mbediso_fs* fs)
         fs->directories = NULL;
     }
 
+    mbediso_filter_dtor(&fs->path_filter);
+
     if(fs->archive_path)
     {
         free(fs->archive_path);
@@ -278,7 +302,46 @@ static bool s_mbediso_check_path_segments(const char* path, bool* skip_segment,
     return true;
 }
 
-bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_location* out)
+/* checks the path filter, hashing the non-skipped segments in the same way as s_mbediso_fs_build_path_filter */
+static bool s_mbediso_fs_path_may_exist(const struct mbediso_fs* fs, const char* path, const bool* skip_segment)
+{
+    uint64_t hash = MBEDISO_UTIL_HASH_INIT;
+    bool any_segment = false;
+
+    const char* segment_start = path;
+    int path_part = 0;
+
+    while(*segment_start != '\0')
+    {
+        const char* segment_end = segment_start;
+
+        while(*segment_end != '/' && *segment_end != '\0')
+            segment_end++;
+
+        if(!skip_segment[path_part])
+        {
+            if(any_segment)
+                hash = mbediso_util_hash(hash, (const uint8_t*)"/", 1);
+
+            hash = mbediso_util_hash(hash, (const uint8_t*)segment_start, segment_end - segment_start);
+            any_segment = true;
+        }
+
+        if(*segment_end == '\0')
+            break;
+
+        segment_start = segment_end + 1;
+        path_part++;
+    }
+
+    // the root always exists
+    if(!any_segment)
+        return true;
+
+    return mbediso_filter_may_contain(&fs->path_filter, hash);
+}
+
+static bool s_mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_location* out, bool load_result)
 {
     // check which paths to skip (`.`, victims of `..`, and invalid `..`)
     // array initialized by callee
@@ -288,6 +351,10 @@ bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_l
     if(!s_mbediso_check_path_segments(path, skip_segment + 0, skip_segment + 16))
         return false;
 
+    // reject paths that are definitely missing, without searching or locking
+    if(fs->path_filter.blocks && !s_mbediso_fs_path_may_exist(fs, path, skip_segment))
+        return false;
+
 
     struct mbediso_io* io = NULL;
     struct mbediso_location* cur_loc = &fs->root_dir_entry;
@@ -374,7 +441,7 @@ bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_l
     }
 
     // prefer to load a directory before returning it
-    if(cur_loc != out && cur_loc->directory && cur_loc->length != 0)
+    if(load_result && cur_loc != out && cur_loc->directory && cur_loc->length != 0)
     {
         if(!io)
             io = mbediso_fs_reserve_io(fs);
@@ -389,6 +456,94 @@ bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_l
     return true;
 }
 
+bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_location* out)
+{
+    return s_mbediso_fs_lookup(fs, path, out, true);
+}
+
+bool mbediso_fs_lookup_noload(struct mbediso_fs* fs, const char* path, struct mbediso_location* out)
+{
+    return s_mbediso_fs_lookup(fs, path, out, false);
+}
+
+struct mbediso_fs_filter_stack_frame
+{
+    const struct mbediso_directory* dir;
+    uint32_t entry_index;
+    uint32_t name_length;
+    uint64_t prefix_hash;
+    struct mbediso_name name;
+};
+
+/* adds the hash of every path in the (fully loaded) filesystem to the path filter; leaves the filter unused on any failure */
+static void s_mbediso_fs_build_path_filter(struct mbediso_fs* fs)
+{
+    if(fs->root_dir_entry.length != 0 || fs->root_dir_entry.sector >= fs->directory_count)
+        return;
+
+    uint32_t path_count = 0;
+    for(uint32_t i = 0; i < fs->directory_count; i++)
+        path_count += fs->directories[i].entry_count;
+
+    if(!mbediso_filter_alloc(&fs->path_filter, path_count))
+        return;
+
+    // a path may have at most 16 segments, so deeper entries can never be looked up
+    struct mbediso_fs_filter_stack_frame* stack = malloc(16 * sizeof(struct mbediso_fs_filter_stack_frame));
+    if(!stack)
+    {
+        mbediso_filter_dtor(&fs->path_filter);
+        return;
+    }
+
+    uint32_t stack_level = 0;
+
+    stack[0].dir = &fs->directories[fs->root_dir_entry.sector];
+    stack[0].entry_index = 0;
+    stack[0].name_length = 0;
+    stack[0].prefix_hash = MBEDISO_UTIL_HASH_INIT;
+
+    while(true)
+    {
+        struct mbediso_fs_filter_stack_frame* const cur_frame = &stack[stack_level];
+
+        if(cur_frame->entry_index >= cur_frame->dir->entry_count)
+        {
+            if(stack_level == 0)
+                break;
+
+            stack_level--;
+            continue;
+        }
+
+        const struct mbediso_dir_entry* cur_entry = &cur_frame->dir->entries[cur_frame->entry_index];
+        mbediso_directory_next_name(cur_frame->dir, cur_frame->entry_index, &cur_frame->name, &cur_frame->name_length);
+        cur_frame->entry_index++;
+
+        uint64_t hash = mbediso_util_hash(cur_frame->prefix_hash, cur_frame->name.buffer, cur_frame->name_length);
+        mbediso_filter_add(&fs->path_filter, hash);
+
+        if(!cur_entry->l.directory || stack_level + 1 >= 16)
+            continue;
+
+        // an unloaded directory means its contents are unknown, so the filter cannot be trusted
+        if(cur_entry->l.length != 0 || cur_entry->l.sector >= fs->directory_count)
+        {
+            mbediso_filter_dtor(&fs->path_filter);
+            break;
+        }
+
+        stack_level++;
+
+        stack[stack_level].dir = &fs->directories[cur_entry->l.sector];
+        stack[stack_level].entry_index = 0;
+        stack[stack_level].name_length = 0;
+        stack[stack_level].prefix_hash = mbediso_util_hash(hash, (const uint8_t*)"/", 1);
+    }
+
+    free(stack);
+}
+
 struct mbediso_fs_scan_stack_frame
 {
     // this is currently safe, but should become an index if the directory entries become allocated in a single vector
@@ -486,6 +641,8 @@ int mbediso_fs_full_scan(struct mbediso_fs* fs, struct mbediso_io* io)
     // success: mark filesystem as scanned
     fs->fully_scanned = true;
 
+    s_mbediso_fs_build_path_filter(fs);
+
     return 0;
 }
 
@@ -522,6 +679,8 @@ static struct mbediso_io* s_mbediso_fs_reserve_io_fp(struct mbediso_fs* fs, FILE
     if(fs->io_pool_size > fs->io_pool_used)
     {
         struct mbediso_io* ret = fs->io_pool[fs->io_pool_used++];
+        ret->profile = fs->profile;
+        ret->read_ahead = fs->read_ahead;
         mbediso_mutex_unlock(fs->io_pool_mutex);
         return ret;
     }
@@ -550,6 +709,9 @@ static struct mbediso_io* s_mbediso_fs_reserve_io_fp(struct mbediso_fs* fs, FILE
         return NULL;
     }
 
+    io->profile = fs->profile;
+    io->read_ahead = fs->read_ahead;
+
     fs->io_pool[fs->io_pool_size++] = io;
     fs->io_pool_used++;
 
@@ -558,6 +720,121 @@ static struct mbediso_io* s_mbediso_fs_reserve_io_fp(struct mbediso_fs* fs, FILE
     return io;
 }
 
+void mbediso_fs_get_stats(struct mbediso_fs* fs, struct mbediso_stats* stats, bool reset)
+{
+    mbediso_mutex_lock(fs->io_pool_mutex);
+
+    *stats = fs->stats;
+
+    if(reset)
+    {
+        fs->stats.bytes_read = 0;
+        fs->stats.blocks_decoded = 0;
+    }
+
+    mbediso_mutex_unlock(fs->io_pool_mutex);
+}
+
+void mbediso_fs_set_read_ahead(struct mbediso_fs* fs, uint32_t bytes)
+{
+    mbediso_mutex_lock(fs->io_pool_mutex);
+    fs->read_ahead = bytes;
+    mbediso_mutex_unlock(fs->io_pool_mutex);
+}
+
+int mbediso_fs_record_profile(struct mbediso_fs* fs)
+{
+    mbediso_mutex_lock(fs->io_pool_mutex);
+
+    if(!fs->profile)
+    {
+        struct mbediso_profile* profile = malloc(sizeof(struct mbediso_profile));
+
+        if(profile && mbediso_profile_ctor(profile))
+            fs->profile = profile;
+        else if(profile)
+        {
+            mbediso_profile_dtor(profile);
+            free(profile);
+        }
+    }
+
+    int ret = (fs->profile) ? 0 : -1;
+
+    mbediso_mutex_unlock(fs->io_pool_mutex);
+
+    return ret;
+}
+
+int mbediso_fs_replay_profile(struct mbediso_fs* fs, struct mbediso_profile* profile)
+{
+    // split long ranges, so that foreground reads are not held up behind them
+    const uint32_t c_chunk_sectors = 128;
+
+    struct mbediso_async* async = mbediso_fs_get_async(fs);
+    if(!async)
+        return -1;
+
+    mbediso_profile_sort(profile);
+
+    for(uint32_t i = 0; i < profile->range_count; i++)
+    {
+        const struct mbediso_profile_range* range = &profile->ranges[i];
+
+        // 64-bit, so that stepping past a count near UINT32_MAX cannot wrap around
+        for(uint64_t done = 0; done < range->sector_count; done += c_chunk_sectors)
+        {
+            uint32_t sector_count = (uint32_t)(range->sector_count - done);
+            if(sector_count > c_chunk_sectors)
+                sector_count = c_chunk_sectors;
+
+            struct mbediso_async_request* request = malloc(sizeof(struct mbediso_async_request));
+            if(!request)
+                return -1;
+
+            request->offset = ((uint64_t)range->sector + done) * 2048;
+            request->length = (size_t)sector_count * 2048;
+            request->buffer = NULL;
+            request->priority = MBEDISO_PRIORITY_PREFETCH;
+            request->callback = NULL;
+            request->userdata = NULL;
+
+            mbediso_async_submit(async, request);
+        }
+    }
+
+    return 0;
+}
+
+struct mbediso_async* mbediso_fs_get_async(struct mbediso_fs* fs)
+{
+    if(!fs)
+        return NULL;
+
+    mbediso_mutex_lock(fs->io_pool_mutex);
+
+    if(!fs->async)
+        fs->async = mbediso_async_alloc(fs);
+
+    struct mbediso_async* ret = fs->async;
+
+    mbediso_mutex_unlock(fs->io_pool_mutex);
+
+    return ret;
+}
+
+struct mbediso_async* mbediso_fs_find_async(struct mbediso_fs* fs)
+{
+    if(!fs)
+        return NULL;
+
+    mbediso_mutex_lock(fs->io_pool_mutex);
+    struct mbediso_async* ret = fs->async;
+    mbediso_mutex_unlock(fs->io_pool_mutex);
+
+    return ret;
+}
+
 struct mbediso_io* mbediso_fs_reserve_io(struct mbediso_fs* fs)
 {
     return s_mbediso_fs_reserve_io_fp(fs, NULL);
@@ -574,6 +851,11 @@ void mbediso_fs_release_io(struct mbediso_fs* fs, struct mbediso_io* io)
     {
         if(fs->io_pool[i] == io)
         {
+            fs->stats.bytes_read += io->stats.bytes_read;
+            fs->stats.blocks_decoded += io->stats.blocks_decoded;
+            io->stats.bytes_read = 0;
+            io->stats.blocks_decoded = 0;
+
             fs->io_pool_used--;
             fs->io_pool[i] = fs->io_pool[fs->io_pool_used];
             fs->io_pool[fs->io_pool_used] = io;
@@ -23,10 +23,16 @@
 #include <stdbool.h>
 
 #include "internal/directory.h"
+#include "internal/filter.h"
+
+#include "mbediso/fs.h"
 
 struct mbediso_lz4_header;
 typedef void* mbediso_mutex_t;
 
+struct mbediso_async;
+struct mbediso_profile;
+
 struct mbediso_fs
 {
     /* Will soon be more flexible: path to give fopen when creating a new io. If non-null, owned by the mbediso_fs object. */
@@ -59,6 +65,19 @@ struct mbediso_fs
     struct mbediso_location root_dir_entry;
     bool fully_scanned;
 
+    /* filter of full path hashes, built by a successful full scan; used to reject missing paths before any lookup */
+    struct mbediso_filter path_filter;
+
+    /* records the archive ranges read by IOs reserved while it is set */
+    struct mbediso_profile* profile;
+
+    /* work done by released IOs, and the read-ahead given to reserved IOs (guarded by the io pool mutex) */
+    struct mbediso_stats stats;
+    uint32_t read_ahead;
+
+    /* worker pool for async reads, created on first use */
+    struct mbediso_async* async;
+
     /* locks for the io pool and the lookup function (which may modify the fs) */
     mbediso_mutex_t io_pool_mutex;
     mbediso_mutex_t lookup_mutex;
@@ -82,7 +101,27 @@ void mbediso_fs_free_directory(struct mbediso_fs* fs, uint32_t dir_index);
 
 bool mbediso_fs_lookup(struct mbediso_fs* fs, const char* path, struct mbediso_location* out);
 
+/* like mbediso_fs_lookup, but does not load the directory at the end of path (only directories along the way) */
+bool mbediso_fs_lookup_noload(struct mbediso_fs* fs, const char* path, struct mbediso_location* out);
+
 struct mbediso_io* mbediso_fs_reserve_io(struct mbediso_fs* fs);
 void mbediso_fs_release_io(struct mbediso_fs* fs, struct mbediso_io* io);
 
+/* copies (and optionally resets) the work done by released IOs */
+void mbediso_fs_get_stats(struct mbediso_fs* fs, struct mbediso_stats* stats, bool reset);
+
+void mbediso_fs_set_read_ahead(struct mbediso_fs* fs, uint32_t bytes);
+
+/* starts recording the archive ranges read through the fs */
+int mbediso_fs_record_profile(struct mbediso_fs* fs);
+
+/* queues background prefetches of the archive ranges in profile, in archive order */
+int mbediso_fs_replay_profile(struct mbediso_fs* fs, struct mbediso_profile* profile);
+
+/* returns the fs's async worker pool, creating it if needed */
+struct mbediso_async* mbediso_fs_get_async(struct mbediso_fs* fs);
+
+/* returns the fs's async worker pool, or NULL if nothing has created it yet */
+struct mbediso_async* mbediso_fs_find_async(struct mbediso_fs* fs);
+
 int mbediso_fs_full_scan(struct mbediso_fs* fs, struct mbediso_io* io);
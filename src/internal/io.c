@@ -24,6 +24,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef MBEDISO_HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <lz4.h>
 
 #include "mbediso.h"
@@ -31,6 +36,7 @@
 #include "internal/io.h"
 #include "internal/io_priv.h"
 #include "internal/lz4_header.h"
+#include "internal/profile.h"
 
 #ifdef __NDS__
 static const uint32_t c_max_buffer_capacity = 32 * 1024;
@@ -46,6 +52,10 @@ static struct mbediso_io* s_mbediso_io_from_file_unc(FILE* file)
         return NULL;
 
     io->tag = MBEDISO_IO_TAG_UNC;
+    io->profile = NULL;
+    io->stats.bytes_read = 0;
+    io->stats.blocks_decoded = 0;
+    io->read_ahead = 0;
     io->file = file;
     io->filepos = -1;
 
@@ -69,6 +79,10 @@ static struct mbediso_io* s_mbediso_io_from_file_lz4(FILE* file, struct mbediso_
         return NULL;
 
     io->tag = MBEDISO_IO_TAG_LZ4;
+    io->profile = NULL;
+    io->stats.bytes_read = 0;
+    io->stats.blocks_decoded = 0;
+    io->read_ahead = 0;
     io->file = file;
     io->header = header;
 
@@ -104,6 +118,17 @@ struct mbediso_io* mbediso_io_from_file(FILE* file, struct mbediso_lz4_header* h
         return s_mbediso_io_from_file_lz4(file, header);
 }
 
+/* forgets the cached block if it is a stored block, which points into the file buffer rather than the decompression buffer */
+static void s_mbediso_io_lz4_invalidate_stored_block(struct mbediso_io_lz4* io)
+{
+    if(io->public_buffer == io->decompression_buffer)
+        return;
+
+    io->buffer_logical_pos = -1;
+    io->buffer_length = 0;
+    io->public_buffer = io->decompression_buffer;
+}
+
 static void s_mbediso_io_lz4_prepare_file_priv(struct mbediso_io_lz4* io, uint32_t read_start, uint32_t min_bytes, uint32_t want_bytes)
 {
     // fast path if the required range is already loaded
@@ -113,10 +138,18 @@ static void s_mbediso_io_lz4_prepare_file_priv(struct mbediso_io_lz4* io, uint32
             return;
     }
 
+    // the file buffer is about to be overwritten (or reallocated)
+    s_mbediso_io_lz4_invalidate_stored_block(io);
+
     io->file_buffer_length = 0;
 
-    if(want_bytes > c_max_buffer_capacity)
-        want_bytes = c_max_buffer_capacity;
+    uint32_t max_bytes = (io->read_ahead) ? io->read_ahead : c_max_buffer_capacity;
+    if(want_bytes > max_bytes)
+        want_bytes = max_bytes;
+
+    // always read at least the requested block (which may exceed the read-ahead for stored 64 KiB blocks)
+    if(want_bytes < min_bytes)
+        want_bytes = min_bytes;
 
     if(want_bytes > io->file_buffer_capacity)
     {
@@ -141,35 +174,22 @@ static void s_mbediso_io_lz4_prepare_file_priv(struct mbediso_io_lz4* io, uint32
         to_read = io->file_buffer_capacity;
 
     int did_read = fread(io->file_buffer, 1, to_read, io->file);
+    io->stats.bytes_read += did_read;
 
     io->file_pos = read_start + did_read;
     io->file_buffer_pos = read_start;
     io->file_buffer_length = did_read;
 }
 
-static bool s_mbediso_io_lz4_prepare(struct mbediso_io_lz4* io, uint32_t logical_pos, uint32_t want_bytes)
+/* loads block's compressed data into the file buffer, pointing *data at it; returns the block's header word (with the stored flag), or 0 on failure */
+static uint32_t s_mbediso_io_lz4_load_block(struct mbediso_io_lz4* io, uint32_t block, uint32_t want_bytes, const uint8_t** data)
 {
-    if(logical_pos > io->buffer_logical_pos)
-    {
-        if(logical_pos < io->buffer_logical_pos + io->buffer_length)
-            return true;
-
-        // check for the case where we are on the last block and a position past the end was requested
-        if(logical_pos < io->buffer_logical_pos + io->header->block_size)
-            return false;
-    }
-
-
-    uint32_t block = logical_pos / io->header->block_size;
-    if(block >= io->header->block_count)
-        return false;
-
     uint32_t read_start = io->header->block_offsets[block];
     uint32_t min_bytes = 4 + io->header->block_size;
     if(block + 1 < io->header->block_count)
         min_bytes = io->header->block_offsets[block + 1] - read_start;
 
-    uint32_t end_block = ((logical_pos + want_bytes) / io->header->block_size) + 1;
+    uint32_t end_block = ((block * io->header->block_size + want_bytes) / io->header->block_size) + 1;
     uint32_t read_end;
     if(end_block >= io->header->block_count)
         read_end = io->header->block_offsets[io->header->block_count - 1] + 4 + io->header->block_size;
@@ -181,36 +201,61 @@ static bool s_mbediso_io_lz4_prepare(struct mbediso_io_lz4* io, uint32_t logical
 
     // gather the read buffer for this block
     if(read_start < io->file_buffer_pos || read_start >= io->file_buffer_pos + io->file_buffer_length)
-        return false;
+        return 0;
 
     const uint8_t* block_buffer = io->file_buffer + (read_start - io->file_buffer_pos);
     uint32_t block_buffer_size = (io->file_buffer_length + io->file_buffer_pos) - read_start;
 
     // ensure we have a complete header
     if(block_buffer_size < 4)
-        return false;
+        return 0;
+
+    uint32_t block_header = (uint32_t)block_buffer[0] | ((uint32_t)block_buffer[1] << 8) | ((uint32_t)block_buffer[2] << 16) | ((uint32_t)block_buffer[3] << 24);
+    uint32_t compressed_length = block_header & ~(uint32_t)0x80000000;
+
+    if(compressed_length == 0 || compressed_length > io->header->block_size)
+        return 0;
+
+    // check that we have the entire block in memory
+    if(block_buffer_size - 4 < compressed_length)
+        return 0;
 
-    uint32_t compressed_length = (block_buffer[0] << 0) + (block_buffer[1] << 8) + (block_buffer[2] << 16) + (block_buffer[3] << 24);
+    *data = block_buffer + 4;
+    return block_header;
+}
 
-    bool is_uncompressed = (compressed_length & 0x80000000);
-    compressed_length &= ~(uint32_t)0x80000000;
+static bool s_mbediso_io_lz4_prepare(struct mbediso_io_lz4* io, uint32_t logical_pos, uint32_t want_bytes)
+{
+    if(logical_pos > io->buffer_logical_pos)
+    {
+        if(logical_pos < io->buffer_logical_pos + io->buffer_length)
+            return true;
 
-    if(compressed_length > io->header->block_size)
+        // check for the case where we are on the last block and a position past the end was requested
+        if(logical_pos < io->buffer_logical_pos + io->header->block_size)
+            return false;
+    }
+
+
+    uint32_t block = logical_pos / io->header->block_size;
+    if(block >= io->header->block_count)
         return false;
 
-    // done with the header
-    block_buffer_size -= 4;
-    block_buffer += 4;
+    const uint8_t* block_buffer;
+    uint32_t block_header = s_mbediso_io_lz4_load_block(io, block, logical_pos % io->header->block_size + want_bytes, &block_buffer);
 
-    // check that we have the entire block in memory
-    if(block_buffer_size < compressed_length)
+    if(block_header == 0)
         return false;
 
-    uint32_t decompressed_length = 0;
+    bool is_uncompressed = (block_header & 0x80000000);
+    uint32_t compressed_length = block_header & ~(uint32_t)0x80000000;
+
+    int decompressed_length = 0;
 
     if(!is_uncompressed)
     {
         decompressed_length = LZ4_decompress_safe((const char*)block_buffer, (char*)io->decompression_buffer, compressed_length, io->header->block_size);
+        io->stats.blocks_decoded++;
         io->public_buffer = io->decompression_buffer;
     }
     else
@@ -219,7 +264,7 @@ static bool s_mbediso_io_lz4_prepare(struct mbediso_io_lz4* io, uint32_t logical
         io->public_buffer = block_buffer;
     }
 
-    if(decompressed_length == 0)
+    if(decompressed_length <= 0)
         return false;
 
     io->buffer_logical_pos = block * io->header->block_size;
@@ -232,11 +277,40 @@ static bool s_mbediso_io_lz4_prepare(struct mbediso_io_lz4* io, uint32_t logical
     return true;
 }
 
+/* decompresses an entire block straight into dest (which must hold block_size bytes), bypassing the block cache; returns the block's length, or 0 on failure */
+static uint32_t s_mbediso_io_lz4_read_block_into(struct mbediso_io_lz4* io, uint32_t block, uint8_t* dest, uint32_t want_bytes)
+{
+    const uint8_t* block_buffer;
+    uint32_t block_header = s_mbediso_io_lz4_load_block(io, block, want_bytes, &block_buffer);
+
+    if(block_header == 0)
+        return 0;
+
+    uint32_t compressed_length = block_header & ~(uint32_t)0x80000000;
+
+    if(block_header & 0x80000000)
+    {
+        memcpy(dest, block_buffer, compressed_length);
+        return compressed_length;
+    }
+
+    int decompressed_length = LZ4_decompress_safe((const char*)block_buffer, (char*)dest, compressed_length, io->header->block_size);
+    io->stats.blocks_decoded++;
+
+    if(decompressed_length <= 0)
+        return 0;
+
+    return decompressed_length;
+}
+
 const uint8_t* mbediso_io_read_sector(struct mbediso_io* _io, uint32_t sector)
 {
     if(!_io)
         return NULL;
 
+    if(_io->profile)
+        mbediso_profile_add(_io->profile, (uint64_t)sector * 2048, 2048);
+
     if(_io->tag == MBEDISO_IO_TAG_LZ4)
     {
         struct mbediso_io_lz4* io = (struct mbediso_io_lz4*)_io;
@@ -269,7 +343,10 @@ const uint8_t* mbediso_io_read_sector(struct mbediso_io* _io, uint32_t sector)
             }
         }
 
-        if(fread(io->buffer, 1, 2048, io->file) != 2048)
+        size_t got = fread(io->buffer, 1, 2048, io->file);
+        io->stats.bytes_read += got;
+
+        if(got != 2048)
         {
             // printf("read failed...\n");
 
@@ -290,6 +367,9 @@ size_t mbediso_io_read_direct(struct mbediso_io* _io, uint8_t* dest, uint64_t of
     if(!_io)
         return 0;
 
+    if(_io->profile)
+        mbediso_profile_add(_io->profile, offset, bytes);
+
     if(_io->tag == MBEDISO_IO_TAG_LZ4)
     {
         struct mbediso_io_lz4* io = (struct mbediso_io_lz4*)_io;
@@ -298,6 +378,30 @@ size_t mbediso_io_read_direct(struct mbediso_io* _io, uint8_t* dest, uint64_t of
 
         while(bytes > 0)
         {
+            // decompress whole uncached blocks straight into the destination
+            bool is_cached = offset >= io->buffer_logical_pos && offset < io->buffer_logical_pos + io->buffer_length;
+
+            if(!is_cached && offset % io->header->block_size == 0 && bytes >= io->header->block_size)
+            {
+                uint32_t block = offset / io->header->block_size;
+                if(block >= io->header->block_count)
+                    return bytes_wanted - bytes;
+
+                uint32_t got = s_mbediso_io_lz4_read_block_into(io, block, dest, bytes);
+                if(got == 0)
+                    return bytes_wanted - bytes;
+
+                dest += got;
+                bytes -= got;
+                offset += got;
+
+                // a short block must be the last one
+                if(got < io->header->block_size)
+                    return bytes_wanted - bytes;
+
+                continue;
+            }
+
             if(!s_mbediso_io_lz4_prepare(io, offset, bytes))
                 return bytes_wanted - bytes;
 
@@ -336,6 +440,8 @@ size_t mbediso_io_read_direct(struct mbediso_io* _io, uint8_t* dest, uint64_t of
         while(bytes > 0)
         {
             size_t got = fread(dest, 1, bytes, io->file);
+            io->stats.bytes_read += got;
+
             if(got == 0)
                 return io->filepos - offset;
 
@@ -350,6 +456,131 @@ size_t mbediso_io_read_direct(struct mbediso_io* _io, uint8_t* dest, uint64_t of
     return false;
 }
 
+void mbediso_io_prefetch(struct mbediso_io* _io, uint64_t offset, uint64_t bytes)
+{
+    if(!_io || bytes == 0)
+        return;
+
+    if(_io->tag == MBEDISO_IO_TAG_LZ4)
+    {
+        struct mbediso_io_lz4* io = (struct mbediso_io_lz4*)_io;
+
+        uint64_t first_block = offset / io->header->block_size;
+        uint64_t end_block = (offset + bytes - 1) / io->header->block_size + 1;
+
+        if(first_block >= io->header->block_count)
+            return;
+
+        // stream the compressed blocks through the file buffer (which drops this io's cached block if it is a stored one)
+        uint32_t read_pos = io->header->block_offsets[first_block];
+        uint32_t read_end;
+        if(end_block >= io->header->block_count)
+            read_end = io->header->block_offsets[io->header->block_count - 1] + 4 + io->header->block_size;
+        else
+            read_end = io->header->block_offsets[end_block];
+
+        while(read_pos < read_end)
+        {
+            s_mbediso_io_lz4_prepare_file_priv(io, read_pos, 1, read_end - read_pos);
+
+            if(io->file_buffer_length == 0)
+                break;
+
+            read_pos = io->file_buffer_pos + io->file_buffer_length;
+        }
+    }
+    else if(_io->tag == MBEDISO_IO_TAG_UNC)
+    {
+        struct mbediso_io_unc* io = (struct mbediso_io_unc*)_io;
+
+        if(io->filepos != offset && fseek(io->file, offset, SEEK_SET))
+        {
+            io->filepos = -1;
+            return;
+        }
+
+        io->filepos = offset;
+
+        while(bytes > 0)
+        {
+            size_t got = fread(io->buffer, 1, (bytes < 2048) ? bytes : 2048, io->file);
+            io->stats.bytes_read += got;
+
+            if(got == 0)
+                break;
+
+            bytes -= got;
+            io->filepos += got;
+        }
+    }
+}
+
+const uint8_t* mbediso_io_read_block_view(struct mbediso_io* _io, uint64_t offset, size_t bytes)
+{
+    if(!_io || _io->tag != MBEDISO_IO_TAG_LZ4 || bytes == 0)
+        return NULL;
+
+    struct mbediso_io_lz4* io = (struct mbediso_io_lz4*)_io;
+
+    // the range must lie in a single block
+    if(offset / io->header->block_size != (offset + bytes - 1) / io->header->block_size)
+        return NULL;
+
+    if(!s_mbediso_io_lz4_prepare(io, offset, bytes))
+        return NULL;
+
+    if(io->buffer_logical_pos + io->buffer_length < offset + bytes)
+        return NULL;
+
+    return io->public_buffer + (offset - io->buffer_logical_pos);
+}
+
+const uint8_t* mbediso_io_map(struct mbediso_io* _io, uint64_t offset, size_t bytes, void** map_base, size_t* map_length)
+{
+#ifdef MBEDISO_HAVE_MMAP
+    if(!_io || _io->tag != MBEDISO_IO_TAG_UNC || bytes == 0)
+        return NULL;
+
+    struct mbediso_io_unc* io = (struct mbediso_io_unc*)_io;
+
+    // mappings must begin on a page boundary
+    long page_size = sysconf(_SC_PAGESIZE);
+    if(page_size <= 0)
+        return NULL;
+
+    uint64_t map_offset = offset - offset % (uint64_t)page_size;
+    size_t length = (size_t)(offset - map_offset) + bytes;
+
+    void* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(io->file), (off_t)map_offset);
+    if(base == MAP_FAILED)
+        return NULL;
+
+    *map_base = base;
+    *map_length = length;
+
+    return (const uint8_t*)base + (offset - map_offset);
+#else
+    (void)_io;
+    (void)offset;
+    (void)bytes;
+    (void)map_base;
+    (void)map_length;
+
+    return NULL;
+#endif
+}
+
+void mbediso_io_unmap(void* map_base, size_t map_length)
+{
+#ifdef MBEDISO_HAVE_MMAP
+    if(map_base)
+        munmap(map_base, map_length);
+#else
+    (void)map_base;
+    (void)map_length;
+#endif
+}
+
 void mbediso_io_close(struct mbediso_io* _io)
 {
     if(!_io)
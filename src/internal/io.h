@@ -22,11 +22,23 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include "mbediso/fs.h"
+
 struct mbediso_lz4_header;
+struct mbediso_profile;
 
 struct mbediso_io
 {
     uint8_t tag;
+
+    /* if set, reads are recorded here */
+    struct mbediso_profile* profile;
+
+    /* work done since the io was reserved, collected by the fs on release */
+    struct mbediso_stats stats;
+
+    /* most compressed data to read at once, or 0 for the default */
+    uint32_t read_ahead;
 };
 
 struct mbediso_io* mbediso_io_from_file(FILE* file, struct mbediso_lz4_header* header);
@@ -34,3 +46,13 @@ void mbediso_io_close(struct mbediso_io* io);
 
 const uint8_t* mbediso_io_read_sector(struct mbediso_io* io, uint32_t sector);
 size_t mbediso_io_read_direct(struct mbediso_io* io, uint8_t* dest, uint64_t offset, size_t bytes);
+
+/* reads the archive data backing bytes at offset (without decompressing it), so that later reads find it in the OS cache */
+void mbediso_io_prefetch(struct mbediso_io* io, uint64_t offset, uint64_t bytes);
+
+/* returns a pointer to bytes at offset within the io's current block (valid until the io's next read), or NULL if the range does not lie within a single LZ4 block */
+const uint8_t* mbediso_io_read_block_view(struct mbediso_io* io, uint64_t offset, size_t bytes);
+
+/* maps bytes at offset of an uncompressed archive into memory (the mapping outlives the io); returns NULL if unsupported */
+const uint8_t* mbediso_io_map(struct mbediso_io* io, uint64_t offset, size_t bytes, void** map_base, size_t* map_length);
+void mbediso_io_unmap(void* map_base, size_t map_length);
@@ -22,12 +22,20 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include "mbediso/fs.h"
+
 #define MBEDISO_IO_TAG_UNC 1
 #define MBEDISO_IO_TAG_LZ4 2
 
+struct mbediso_profile;
+
+/* the initial members must match struct mbediso_io */
 struct mbediso_io_unc
 {
     uint8_t tag;
+    struct mbediso_profile* profile;
+    struct mbediso_stats stats;
+    uint32_t read_ahead;
 
     FILE* file;
 
@@ -40,6 +48,9 @@ struct mbediso_io_unc
 struct mbediso_io_lz4
 {
     uint8_t tag;
+    struct mbediso_profile* profile;
+    struct mbediso_stats stats;
+    uint32_t read_ahead;
 
     FILE* file;
     struct mbediso_lz4_header* header;
@@ -21,8 +21,13 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <lz4.h>
+
 #include "internal/lz4_header.h"
 
+/* the largest block size of an LZ4 frame; archives from lz4_pack use at most 64 KiB */
+static const uint32_t c_max_block_size = 4 * 1024 * 1024;
+
 static uint32_t s_swap_endian(uint32_t r)
 {
     return ((uint8_t)(r >> 24) << 0) + ((uint8_t)(r >> 16) << 8) + ((uint8_t)(r >> 8) << 16) + ((uint8_t)(r >> 0) << 24);
@@ -37,19 +42,15 @@ static void s_fix_endian(uint32_t* buffer, uint32_t count, bool big_endian)
         buffer[i] = s_swap_endian(buffer[i]);
 }
 
-struct mbediso_lz4_header* mbediso_lz4_header_load(FILE* file)
+/* reads the mbediso skippable frame at the file's current position; trailer_length is the length of the trailer that ends the frame in a streamed archive (0 otherwise) */
+static struct mbediso_lz4_header* s_mbediso_lz4_header_load_frame(FILE* file, uint32_t trailer_length)
 {
-    if(!file)
-        return NULL;
-
     uint8_t read_buffer[4];
 
-    // check magic numbers
-    // LZ4 magic number
-    if(fseek(file, 0x00, SEEK_SET)
-        || fread(read_buffer, 1, 4, file) != 4
-        || read_buffer[0] != 0x04
-        || read_buffer[1] != 0x22
+    // LZ4 skippable frame magic number
+    if(fread(read_buffer, 1, 4, file) != 4
+        || read_buffer[0] != 0x50
+        || read_buffer[1] != 0x2a
         || read_buffer[2] != 0x4d
         || read_buffer[3] != 0x18)
     {
@@ -58,11 +59,8 @@ struct mbediso_lz4_header* mbediso_lz4_header_load(FILE* file)
 
     // size of mbediso frame
     uint32_t mbediso_inner_frame_length = 0;
-    if(fseek(file, 0x0F, SEEK_SET)
-        || fread(&mbediso_inner_frame_length, 4, 1, file) != 1)
-    {
+    if(fread(&mbediso_inner_frame_length, 4, 1, file) != 1)
         return NULL;
-    }
 
     s_fix_endian(&mbediso_inner_frame_length, 1, false);
 
@@ -92,13 +90,13 @@ struct mbediso_lz4_header* mbediso_lz4_header_load(FILE* file)
 
     s_fix_endian(&block_size, 1, big_endian);
 
-    if(block_size > 64 * 1024 || block_size < 2048 || (block_size % 2048) != 0)
+    if(block_size > c_max_block_size || block_size < 2048 || (block_size % 2048) != 0)
         return NULL;
 
     uint32_t block_count = (file_size + (block_size - 1)) / block_size;
 
     // check that inner frame is the expected size
-    if(mbediso_inner_frame_length != 12 + block_count * 4)
+    if(mbediso_inner_frame_length != 12 + block_count * 4 + trailer_length)
         return NULL;
 
     // load lookup table from file!
@@ -129,6 +127,216 @@ struct mbediso_lz4_header* mbediso_lz4_header_load(FILE* file)
     return header;
 }
 
+/* returns the decompressed size of a block whose payload follows at the file's position (decoding it into the scratch buffers, each holding block_size bytes), or 0 on failure */
+static uint32_t s_mbediso_lz4_header_block_size(FILE* file, uint32_t block_header, uint32_t block_size, char* compressed, char* decompressed)
+{
+    uint32_t length = block_header & ~(uint32_t)0x80000000;
+
+    if(block_header & 0x80000000)
+        return length;
+
+    if(fread(compressed, 1, length, file) != length)
+        return 0;
+
+    int got = LZ4_decompress_safe(compressed, decompressed, (int)length, (int)block_size);
+
+    return (got > 0) ? (uint32_t)got : 0;
+}
+
+/* walks the blocks of an LZ4 frame from pos up to its endmark, collecting each block's offset into a new array, the last block's decompressed size, and the position after the endmark; every compressed block is decoded, since only its output shows whether it is full */
+static bool s_mbediso_lz4_header_walk_blocks(FILE* file, uint64_t pos, uint32_t block_size, bool block_checksums, uint32_t** out_offsets, uint32_t* out_count, uint32_t* out_last_size, uint64_t* out_end)
+{
+    uint32_t* block_offsets = NULL;
+    uint32_t block_count = 0;
+    uint32_t block_capacity = 0;
+    uint32_t last_size = 0;
+
+    char* compressed = malloc(block_size);
+    char* decompressed = malloc(block_size);
+
+    while(compressed && decompressed)
+    {
+        uint8_t header_bytes[4];
+        if(pos > UINT32_MAX || fseek(file, (long)pos, SEEK_SET) || fread(header_bytes, 1, 4, file) != 4)
+            break;
+
+        uint32_t block_header = (uint32_t)header_bytes[0] | ((uint32_t)header_bytes[1] << 8) | ((uint32_t)header_bytes[2] << 16) | ((uint32_t)header_bytes[3] << 24);
+
+        // endmark
+        if(block_header == 0)
+        {
+            free(compressed);
+            free(decompressed);
+
+            *out_offsets = block_offsets;
+            *out_count = block_count;
+            *out_last_size = last_size;
+            *out_end = pos + 4;
+            return true;
+        }
+
+        uint32_t length = block_header & ~(uint32_t)0x80000000;
+        if(length == 0 || length > block_size)
+            break;
+
+        // only the last block may be short (an LZ4 writer which flushes early makes short blocks anywhere, and these cannot be indexed)
+        if(block_count > 0 && last_size != block_size)
+            break;
+
+        if(block_count == block_capacity)
+        {
+            uint32_t new_capacity = (block_capacity) ? block_capacity * 2 : 64;
+            uint32_t* new_offsets = realloc(block_offsets, new_capacity * sizeof(uint32_t));
+            if(!new_offsets)
+                break;
+
+            block_offsets = new_offsets;
+            block_capacity = new_capacity;
+        }
+
+        last_size = s_mbediso_lz4_header_block_size(file, block_header, block_size, compressed, decompressed);
+        if(last_size == 0)
+            break;
+
+        block_offsets[block_count++] = (uint32_t)pos;
+
+        pos += 4 + (uint64_t)length + (block_checksums ? 4 : 0);
+    }
+
+    free(compressed);
+    free(decompressed);
+    free(block_offsets);
+    return false;
+}
+
+/* builds the block index of a standard LZ4 frame by walking (and decoding) its blocks; requires independent blocks, each holding block_size bytes except the last (as written by the lz4 tool) */
+static struct mbediso_lz4_header* s_mbediso_lz4_header_scan(FILE* file)
+{
+    uint8_t descriptor[8];
+
+    // FLG and BD bytes
+    if(fseek(file, 4, SEEK_SET) || fread(descriptor, 1, 2, file) != 2)
+        return NULL;
+
+    uint8_t flg = descriptor[0];
+    uint8_t bd = descriptor[1];
+
+    bool block_checksums = (flg & 0x10);
+    bool has_content_size = (flg & 0x08);
+    bool content_checksum = (flg & 0x04);
+
+    // version 1, independent blocks, no dictionary
+    if((flg >> 6) != 1 || !(flg & 0x20) || (flg & 0x01) || (flg & 0x02))
+        return NULL;
+
+    uint8_t block_size_id = (bd >> 4) & 7;
+    if(block_size_id < 4)
+        return NULL;
+
+    uint32_t block_size = (uint32_t)(64 * 1024) << (2 * (block_size_id - 4));
+
+    uint64_t file_size = 0;
+    if(has_content_size)
+    {
+        if(fread(descriptor, 1, 8, file) != 8)
+            return NULL;
+
+        for(int i = 7; i >= 0; i--)
+            file_size = (file_size << 8) | descriptor[i];
+    }
+
+    // blocks start after the header checksum
+    uint32_t* block_offsets;
+    uint32_t block_count;
+    uint32_t last_size;
+    uint64_t frame_end;
+
+    if(!s_mbediso_lz4_header_walk_blocks(file, (has_content_size) ? 15 : 7, block_size, block_checksums, &block_offsets, &block_count, &last_size, &frame_end))
+        return NULL;
+
+    if(content_checksum)
+        frame_end += 4;
+
+    // only the first frame is indexed, so it must be the whole file (not one of several concatenated frames)
+    if(fseek(file, 0, SEEK_END) || ftell(file) < 0 || (uint64_t)ftell(file) != frame_end)
+    {
+        free(block_offsets);
+        return NULL;
+    }
+
+    // the blocks must hold exactly the content size, if given
+    uint64_t blocks_size = (block_count) ? (uint64_t)(block_count - 1) * block_size + last_size : 0;
+    if(!has_content_size)
+        file_size = blocks_size;
+
+    if(block_count == 0 || file_size > UINT32_MAX || file_size != blocks_size)
+    {
+        free(block_offsets);
+        return NULL;
+    }
+
+    struct mbediso_lz4_header* header = (struct mbediso_lz4_header*)malloc(sizeof(struct mbediso_lz4_header));
+    if(!header)
+    {
+        free(block_offsets);
+        return NULL;
+    }
+
+    header->block_size = block_size;
+    header->block_count = block_count;
+    header->block_offsets = block_offsets;
+
+    return header;
+}
+
+struct mbediso_lz4_header* mbediso_lz4_header_load(FILE* file)
+{
+    if(!file)
+        return NULL;
+
+    uint8_t read_buffer[8];
+
+    // check magic numbers
+    // LZ4 magic number
+    if(fseek(file, 0x00, SEEK_SET)
+        || fread(read_buffer, 1, 4, file) != 4
+        || read_buffer[0] != 0x04
+        || read_buffer[1] != 0x22
+        || read_buffer[2] != 0x4d
+        || read_buffer[3] != 0x18)
+    {
+        return NULL;
+    }
+
+    // usually, an empty frame followed by the mbediso frame
+    if(fseek(file, 0x0B, SEEK_SET))
+        return NULL;
+
+    struct mbediso_lz4_header* header = s_mbediso_lz4_header_load_frame(file, 0);
+    if(header)
+        return header;
+
+    // a streamed (or indexed) archive: the mbediso frame comes last, and ends with "MITR" and the frame's little-endian length
+    if(!fseek(file, -8, SEEK_END)
+        && fread(read_buffer, 1, 8, file) == 8
+        && read_buffer[0] == 'M'
+        && read_buffer[1] == 'I'
+        && read_buffer[2] == 'T'
+        && read_buffer[3] == 'R')
+    {
+        uint32_t frame_length = (uint32_t)read_buffer[4] | ((uint32_t)read_buffer[5] << 8) | ((uint32_t)read_buffer[6] << 16) | ((uint32_t)read_buffer[7] << 24);
+
+        if(frame_length >= 28 && !fseek(file, -(long)frame_length, SEEK_END))
+            header = s_mbediso_lz4_header_load_frame(file, 8);
+
+        if(header)
+            return header;
+    }
+
+    // otherwise, a standard LZ4 frame
+    return s_mbediso_lz4_header_scan(file);
+}
+
 void mbediso_lz4_header_free(struct mbediso_lz4_header* header)
 {
     if(!header)
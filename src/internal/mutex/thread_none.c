@@ -0,0 +1,61 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+
+#include "internal/mutex/thread.h"
+
+mbediso_cond_t mbediso_cond_alloc()
+{
+    return (mbediso_cond_t)1;
+}
+
+void mbediso_cond_free(mbediso_cond_t cond)
+{
+    (void)cond;
+}
+
+void mbediso_cond_wait(mbediso_cond_t cond, mbediso_mutex_t mutex)
+{
+    (void)cond;
+    (void)mutex;
+}
+
+void mbediso_cond_signal(mbediso_cond_t cond)
+{
+    (void)cond;
+}
+
+void mbediso_cond_broadcast(mbediso_cond_t cond)
+{
+    (void)cond;
+}
+
+mbediso_thread_t mbediso_thread_create(int (*func)(void*), void* data)
+{
+    (void)func;
+    (void)data;
+
+    return NULL;
+}
+
+void mbediso_thread_join(mbediso_thread_t thread)
+{
+    (void)thread;
+}
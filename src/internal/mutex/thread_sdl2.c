@@ -0,0 +1,58 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal/mutex/thread.h"
+
+#include "SDL2/SDL_mutex.h"
+#include "SDL2/SDL_thread.h"
+
+mbediso_cond_t mbediso_cond_alloc(void)
+{
+    return (mbediso_cond_t)SDL_CreateCond();
+}
+
+void mbediso_cond_free(mbediso_cond_t cond)
+{
+    SDL_DestroyCond((SDL_cond*)cond);
+}
+
+void mbediso_cond_wait(mbediso_cond_t cond, mbediso_mutex_t mutex)
+{
+    SDL_CondWait((SDL_cond*)cond, (SDL_mutex*)mutex);
+}
+
+void mbediso_cond_signal(mbediso_cond_t cond)
+{
+    SDL_CondSignal((SDL_cond*)cond);
+}
+
+void mbediso_cond_broadcast(mbediso_cond_t cond)
+{
+    SDL_CondBroadcast((SDL_cond*)cond);
+}
+
+mbediso_thread_t mbediso_thread_create(int (*func)(void*), void* data)
+{
+    return (mbediso_thread_t)SDL_CreateThread(func, "mbediso", data);
+}
+
+void mbediso_thread_join(mbediso_thread_t thread)
+{
+    SDL_WaitThread((SDL_Thread*)thread, NULL);
+}
@@ -0,0 +1,239 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal/profile.h"
+#include "internal/util.h"
+
+/* profiles larger than this are corrupt */
+static const uint32_t c_max_range_count = 16 * 1024 * 1024;
+
+bool mbediso_profile_ctor(struct mbediso_profile* profile)
+{
+    profile->ranges = NULL;
+    profile->range_count = 0;
+    profile->range_capacity = 0;
+
+    profile->mutex = mbediso_mutex_alloc();
+
+    return profile->mutex != NULL;
+}
+
+void mbediso_profile_dtor(struct mbediso_profile* profile)
+{
+    free(profile->ranges);
+    profile->ranges = NULL;
+    profile->range_count = 0;
+    profile->range_capacity = 0;
+
+    if(profile->mutex)
+    {
+        mbediso_mutex_free(profile->mutex);
+        profile->mutex = NULL;
+    }
+}
+
+static bool s_mbediso_profile_reserve(struct mbediso_profile* profile, uint32_t range_count)
+{
+    if(range_count <= profile->range_capacity)
+        return true;
+
+    size_t new_capacity = mbediso_util_first_pow2(range_count);
+    struct mbediso_profile_range* new_ranges = realloc(profile->ranges, new_capacity * sizeof(struct mbediso_profile_range));
+    if(!new_ranges)
+        return false;
+
+    profile->ranges = new_ranges;
+    profile->range_capacity = new_capacity;
+
+    return true;
+}
+
+void mbediso_profile_add(struct mbediso_profile* profile, uint64_t offset, uint64_t bytes)
+{
+    if(bytes == 0)
+        return;
+
+    uint64_t first_sector = offset / 2048;
+    uint64_t end_sector = (offset + bytes + 2047) / 2048;
+
+    if(end_sector > UINT32_MAX)
+        return;
+
+    mbediso_mutex_lock(profile->mutex);
+
+    // extend the last range if this read continues it (the common case for sequential reads)
+    if(profile->range_count > 0)
+    {
+        struct mbediso_profile_range* last = &profile->ranges[profile->range_count - 1];
+        uint64_t last_end = (uint64_t)last->sector + last->sector_count;
+
+        if(first_sector >= last->sector && first_sector <= last_end)
+        {
+            if(end_sector > last_end)
+                last->sector_count = (uint32_t)(end_sector - last->sector);
+
+            mbediso_mutex_unlock(profile->mutex);
+            return;
+        }
+    }
+
+    if(profile->range_count < c_max_range_count && s_mbediso_profile_reserve(profile, profile->range_count + 1))
+    {
+        struct mbediso_profile_range* range = &profile->ranges[profile->range_count++];
+        range->sector = (uint32_t)first_sector;
+        range->sector_count = (uint32_t)(end_sector - first_sector);
+    }
+
+    mbediso_mutex_unlock(profile->mutex);
+}
+
+static void s_mbediso_profile_write_u32(uint8_t* dest, uint32_t value)
+{
+    dest[0] = (uint8_t)(value >> 0);
+    dest[1] = (uint8_t)(value >> 8);
+    dest[2] = (uint8_t)(value >> 16);
+    dest[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t s_mbediso_profile_read_u32(const uint8_t* src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+int mbediso_profile_save(struct mbediso_profile* profile, const char* filename)
+{
+    FILE* f = fopen(filename, "wb");
+    if(!f)
+        return -1;
+
+    mbediso_mutex_lock(profile->mutex);
+
+    uint8_t buffer[8];
+    memcpy(buffer, "MBPF", 4);
+    s_mbediso_profile_write_u32(buffer + 4, profile->range_count);
+
+    bool success = (fwrite(buffer, 1, 8, f) == 8);
+
+    for(uint32_t i = 0; success && i < profile->range_count; i++)
+    {
+        s_mbediso_profile_write_u32(buffer + 0, profile->ranges[i].sector);
+        s_mbediso_profile_write_u32(buffer + 4, profile->ranges[i].sector_count);
+
+        success = (fwrite(buffer, 1, 8, f) == 8);
+    }
+
+    mbediso_mutex_unlock(profile->mutex);
+
+    if(fclose(f) != 0)
+        success = false;
+
+    return success ? 0 : -1;
+}
+
+int mbediso_profile_load(struct mbediso_profile* profile, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if(!f)
+        return -1;
+
+    uint8_t buffer[8];
+
+    if(fread(buffer, 1, 8, f) != 8 || memcmp(buffer, "MBPF", 4) != 0)
+    {
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t range_count = s_mbediso_profile_read_u32(buffer + 4);
+
+    if(range_count > c_max_range_count || !s_mbediso_profile_reserve(profile, range_count))
+    {
+        fclose(f);
+        return -1;
+    }
+
+    for(uint32_t i = 0; i < range_count; i++)
+    {
+        if(fread(buffer, 1, 8, f) != 8)
+        {
+            fclose(f);
+            return -1;
+        }
+
+        profile->ranges[i].sector = s_mbediso_profile_read_u32(buffer + 0);
+        profile->ranges[i].sector_count = s_mbediso_profile_read_u32(buffer + 4);
+
+        // a corrupt range could run past the last 32-bit sector
+        if((uint64_t)profile->ranges[i].sector + profile->ranges[i].sector_count > UINT32_MAX)
+        {
+            fclose(f);
+            return -1;
+        }
+    }
+
+    profile->range_count = range_count;
+
+    fclose(f);
+    return 0;
+}
+
+static int s_mbediso_profile_range_cmp(const void* _a, const void* _b)
+{
+    const struct mbediso_profile_range* a = (const struct mbediso_profile_range*)_a;
+    const struct mbediso_profile_range* b = (const struct mbediso_profile_range*)_b;
+
+    if(a->sector != b->sector)
+        return (a->sector < b->sector) ? -1 : 1;
+
+    return 0;
+}
+
+void mbediso_profile_sort(struct mbediso_profile* profile)
+{
+    if(profile->range_count == 0)
+        return;
+
+    qsort(profile->ranges, profile->range_count, sizeof(struct mbediso_profile_range), s_mbediso_profile_range_cmp);
+
+    uint32_t out = 0;
+
+    for(uint32_t i = 1; i < profile->range_count; i++)
+    {
+        struct mbediso_profile_range* last = &profile->ranges[out];
+        uint64_t last_end = (uint64_t)last->sector + last->sector_count;
+        uint64_t cur_end = (uint64_t)profile->ranges[i].sector + profile->ranges[i].sector_count;
+
+        if(profile->ranges[i].sector <= last_end)
+        {
+            if(cur_end > UINT32_MAX)
+                cur_end = UINT32_MAX;
+
+            if(cur_end > last_end)
+                last->sector_count = (uint32_t)(cur_end - last->sector);
+        }
+        else
+            profile->ranges[++out] = profile->ranges[i];
+    }
+
+    profile->range_count = out + 1;
+}
@@ -0,0 +1,55 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "internal/mutex/mutex.h"
+
+/* a contiguous run of archive sectors */
+struct mbediso_profile_range
+{
+    uint32_t sector;
+    uint32_t sector_count;
+};
+
+/* the archive sectors read through an fs, in first-access order (with consecutive accesses merged) */
+struct mbediso_profile
+{
+    mbediso_mutex_t mutex;
+
+    struct mbediso_profile_range* ranges;
+    uint32_t range_count;
+    uint32_t range_capacity;
+};
+
+bool mbediso_profile_ctor(struct mbediso_profile* profile);
+void mbediso_profile_dtor(struct mbediso_profile* profile);
+
+/* records a read of bytes at offset of the (uncompressed) archive */
+void mbediso_profile_add(struct mbediso_profile* profile, uint64_t offset, uint64_t bytes);
+
+/* the file format is "MBPF", a 32-bit little-endian range count, and then each range's sector and sector count */
+int mbediso_profile_save(struct mbediso_profile* profile, const char* filename);
+int mbediso_profile_load(struct mbediso_profile* profile, const char* filename);
+
+/* sorts the ranges by sector, merging any which touch or overlap */
+void mbediso_profile_sort(struct mbediso_profile* profile);
@@ -70,7 +70,7 @@ int mbediso_string_diff_reconstruct(uint8_t* buffer, size_t buffer_size, const u
     return 0;
 }
 
-int mbediso_string_diff_compact(uint8_t** stringtable, uint32_t* stringtable_size, void* entries, size_t entry_count, size_t entry_size)
+int mbediso_string_diff_compact(uint8_t** stringtable, uint32_t* stringtable_size, void* entries, size_t entry_count, size_t entry_size, size_t restart_interval)
 {
     if(entry_count == 0)
         return 0;
@@ -148,6 +148,14 @@ int mbediso_string_diff_compact(uint8_t** stringtable, uint32_t* stringtable_siz
                 clip_end = true;
         }
 
+        // store restart entries in full, so that no reconstruction needs to look further back
+        if(restart_interval && e % restart_interval == 0)
+        {
+            diff_begin = 0;
+            diff_end = entry->subst_end;
+            clip_end = true;
+        }
+
         // now that last entry has been checked, apply the clipping to it
         const uint8_t* src = *stringtable + last_entry->subst_table_offset;
 
@@ -35,4 +35,5 @@ struct mbediso_string_diff
 };
 
 int mbediso_string_diff_reconstruct(uint8_t* buffer, size_t buffer_size, const uint8_t* stringtable, const void* entries, size_t entry_count, size_t entry_size, size_t top_entry);
-int mbediso_string_diff_compact(uint8_t** stringtable, uint32_t* stringtable_size, void* entries, size_t entry_count, size_t entry_size);
+/* if restart_interval is nonzero, every restart_interval-th entry is stored in full, which bounds the chain of entries needed to reconstruct any name */
+int mbediso_string_diff_compact(uint8_t** stringtable, uint32_t* stringtable_size, void* entries, size_t entry_count, size_t entry_size, size_t restart_interval);
@@ -30,6 +30,177 @@ size_t mbediso_util_first_pow2(size_t capacity)
     return capacity;
 }
 
+uint64_t mbediso_util_hash(uint64_t hash, const uint8_t* data, size_t length)
+{
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+size_t mbediso_util_wildcard_prefix(const uint8_t* pattern, size_t pattern_length)
+{
+    for(size_t i = 0; i < pattern_length; i++)
+    {
+        if(pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[')
+            return i;
+    }
+
+    return pattern_length;
+}
+
+/* reads one UTF-8 codepoint (leniently) and returns the number of bytes it used */
+static size_t s_mbediso_util_utf8_decode(const uint8_t* s, size_t length, uint32_t* codepoint)
+{
+    size_t used = 1;
+    uint32_t c = s[0];
+
+    if(c >= 0xF0)
+    {
+        c &= 0x07;
+        used = 4;
+    }
+    else if(c >= 0xE0)
+    {
+        c &= 0x0F;
+        used = 3;
+    }
+    else if(c >= 0xC0)
+    {
+        c &= 0x1F;
+        used = 2;
+    }
+
+    if(used > length)
+        used = length;
+
+    for(size_t i = 1; i < used; i++)
+        c = (c << 6) | (s[i] & 0x3F);
+
+    *codepoint = c;
+    return used;
+}
+
+/* matches one codepoint against the bracket expression starting after `[`; returns the bracket length including `]`, or 0 if it is unterminated */
+static size_t s_mbediso_util_bracket_match(const uint8_t* pattern, size_t pattern_length, uint32_t c, bool* matched)
+{
+    size_t i = 0;
+    bool negate = false;
+
+    if(i < pattern_length && (pattern[i] == '!' || pattern[i] == '^'))
+    {
+        negate = true;
+        i++;
+    }
+
+    *matched = false;
+    bool first = true;
+
+    while(i < pattern_length && (first || pattern[i] != ']'))
+    {
+        uint32_t lo, hi;
+        i += s_mbediso_util_utf8_decode(pattern + i, pattern_length - i, &lo);
+        hi = lo;
+
+        if(i + 1 < pattern_length && pattern[i] == '-' && pattern[i + 1] != ']')
+        {
+            i++;
+            i += s_mbediso_util_utf8_decode(pattern + i, pattern_length - i, &hi);
+        }
+
+        if(lo <= c && c <= hi)
+            *matched = true;
+
+        first = false;
+    }
+
+    if(i >= pattern_length)
+        return 0;
+
+    if(negate)
+        *matched = !*matched;
+
+    return i + 1;
+}
+
+bool mbediso_util_wildcard_match(const uint8_t* pattern, size_t pattern_length, const uint8_t* name, size_t name_length)
+{
+    size_t p = 0;
+    size_t n = 0;
+
+    // position to resume from after the most recent `*`, if any
+    size_t star_p = (size_t)-1;
+    size_t star_n = 0;
+
+    while(n < name_length)
+    {
+        if(p < pattern_length && pattern[p] == '*')
+        {
+            star_p = ++p;
+            star_n = n;
+            continue;
+        }
+
+        if(p < pattern_length)
+        {
+            uint32_t c;
+            size_t c_length = s_mbediso_util_utf8_decode(name + n, name_length - n, &c);
+
+            if(pattern[p] == '?')
+            {
+                p++;
+                n += c_length;
+                continue;
+            }
+
+            if(pattern[p] == '[')
+            {
+                bool matched;
+                size_t bracket_length = s_mbediso_util_bracket_match(pattern + p + 1, pattern_length - p - 1, c, &matched);
+
+                if(bracket_length == 0 && name[n] == '[')
+                {
+                    // an unterminated `[` is literal
+                    p++;
+                    n++;
+                    continue;
+                }
+
+                if(bracket_length != 0 && matched)
+                {
+                    p += 1 + bracket_length;
+                    n += c_length;
+                    continue;
+                }
+            }
+            else if(pattern[p] == name[n])
+            {
+                p++;
+                n++;
+                continue;
+            }
+        }
+
+        // mismatch: let the last `*` consume one more codepoint
+        if(star_p == (size_t)-1)
+            return false;
+
+        uint32_t c;
+        star_n += s_mbediso_util_utf8_decode(name + star_n, name_length - star_n, &c);
+        p = star_p;
+        n = star_n;
+    }
+
+    // only trailing stars may remain
+    while(p < pattern_length && pattern[p] == '*')
+        p++;
+
+    return p == pattern_length;
+}
+
 int mbediso_util_utf16be_to_utf8(uint8_t* restrict dest, ptrdiff_t capacity, const uint8_t* restrict src, size_t bytes)
 {
     if(bytes & 1)
@@ -21,7 +21,20 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+/* initial state for mbediso_util_hash (64-bit FNV-1a) */
+#define MBEDISO_UTIL_HASH_INIT (uint64_t)(0xcbf29ce484222325ULL)
 
 size_t mbediso_util_first_pow2(size_t capacity);
 
+/* continues a hash over the given bytes, so that a hash of a path can be built segment by segment */
+uint64_t mbediso_util_hash(uint64_t hash, const uint8_t* data, size_t length);
+
+/* returns the length of the pattern's literal prefix (the bytes before its first wildcard character) */
+size_t mbediso_util_wildcard_prefix(const uint8_t* pattern, size_t pattern_length);
+
+/* matches a UTF-8 name against a shell-style pattern supporting `*`, `?`, and `[...]` (with ranges and `!` or `^` negation) */
+bool mbediso_util_wildcard_match(const uint8_t* pattern, size_t pattern_length, const uint8_t* name, size_t name_length);
+
 int mbediso_util_utf16be_to_utf8(uint8_t* restrict dest, ptrdiff_t capacity, const uint8_t* restrict src, size_t bytes);
@@ -19,59 +19,125 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "mbediso/dir.h"
+#include "mbediso/file.h"
 #include "internal/io.h"
 #include "internal/fs.h"
 #include "internal/directory.h"
+#include "internal/util.h"
+#include "internal/mutex/thread.h"
 
-struct mbediso_dir* mbediso_opendir(struct mbediso_fs* fs, const char* name)
+/* longest path that can be built from 16 maximal segments (with separators) */
+#define MBEDISO_PATH_CAPACITY (16 * sizeof(struct mbediso_name))
+
+/* returns the directory at a location, loading it to the heap if needed (in which case on_heap is set) */
+static struct mbediso_directory* s_mbediso_acquire_directory(struct mbediso_fs* fs, const struct mbediso_location* loc, bool* on_heap)
 {
-    struct mbediso_location loc;
-    if(!mbediso_fs_lookup(fs, name, &loc))
+    if(!loc->directory)
         return NULL;
 
-    if(!loc.directory)
+    // preloaded directory
+    if(loc->length == 0)
+    {
+        if(loc->sector >= fs->directory_count)
+            return NULL;
+
+        *on_heap = false;
+        return &fs->directories[loc->sector];
+    }
+
+    // need to load
+    struct mbediso_directory* directory = malloc(sizeof(struct mbediso_directory));
+    if(!directory)
         return NULL;
 
-    if(loc.length == 0 && loc.sector >= fs->directory_count)
+    if(!mbediso_directory_ctor(directory))
+    {
+        free(directory);
+        return NULL;
+    }
+
+    struct mbediso_io* io = mbediso_fs_reserve_io(fs);
+
+    if(!io || mbediso_directory_load(directory, io, loc->sector, loc->length) != 0)
+    {
+        mbediso_fs_release_io(fs, io);
+        mbediso_directory_dtor(directory);
+        free(directory);
+        return NULL;
+    }
+
+    // loaded successfully, just need to clean up here
+    mbediso_fs_release_io(fs, io);
+
+    *on_heap = true;
+    return directory;
+}
+
+/* returns the current address of a directory from s_mbediso_acquire_directory (index being its location's sector): a preloaded directory lives in fs->directories, which moves whenever the fs loads another directory, as a user callback may make it do */
+static struct mbediso_directory* s_mbediso_refresh_directory(struct mbediso_fs* fs, struct mbediso_directory* directory, bool on_heap, uint32_t index)
+{
+    if(on_heap)
+        return directory;
+
+    return &fs->directories[index];
+}
+
+static void s_mbediso_release_directory(struct mbediso_directory* directory, bool on_heap)
+{
+    if(!on_heap)
+        return;
+
+    mbediso_directory_dtor(directory);
+    free(directory);
+}
+
+struct mbediso_dir* mbediso_opendir(struct mbediso_fs* fs, const char* name)
+{
+    struct mbediso_location loc;
+    if(!mbediso_fs_lookup(fs, name, &loc))
         return NULL;
 
     struct mbediso_dir* dir = malloc(sizeof(struct mbediso_dir));
     if(!dir)
         return NULL;
 
-    // preloaded directory
-    if(loc.length == 0 && loc.sector < fs->directory_count)
+    dir->directory = s_mbediso_acquire_directory(fs, &loc, &dir->on_heap);
+    if(!dir->directory)
     {
-        dir->directory = &fs->directories[loc.sector];
-        dir->on_heap = false;
+        free(dir);
+        return NULL;
     }
-    // need to load
-    else
-    {
-        dir->directory = malloc(sizeof(struct mbediso_directory));
-        dir->on_heap = true;
 
-        struct mbediso_io* io = NULL;
+    dir->fs = fs;
+    dir->entry_index = 0;
+    dir->entry_end = dir->directory->entry_count;
+    return dir;
+}
+
+struct mbediso_dir* mbediso_opendir_prefix(struct mbediso_fs* fs, const char* name, const char* prefix)
+{
+    struct mbediso_dir* dir = mbediso_opendir(fs, name);
+    if(!dir)
+        return NULL;
 
-        if(!dir->directory
-            || !mbediso_directory_ctor(dir->directory)
-            || (io = mbediso_fs_reserve_io(fs)) == NULL
-            || mbediso_directory_load(dir->directory, io, loc.sector, loc.length) != 0
-        )
+    mbediso_directory_prefix_range(dir->directory, prefix, strlen(prefix), &dir->entry_index, &dir->entry_end);
+
+    // mbediso_readdir updates the name of the previous entry, so it needs to be present
+    if(dir->entry_index > 0 && dir->entry_index < dir->entry_end)
+    {
+        struct mbediso_name prev_name;
+        if(mbediso_directory_get_name(dir->directory, dir->entry_index - 1, &prev_name) < 0)
         {
-            mbediso_fs_release_io(fs, io);
             mbediso_closedir(dir);
             return NULL;
         }
 
-        // loaded successfully, just need to clean up here
-        mbediso_fs_release_io(fs, io);
+        memcpy(dir->dirent.d_name, prev_name.buffer, sizeof(dir->dirent.d_name));
     }
 
-    dir->fs = fs;
-    dir->entry_index = 0;
     return dir;
 }
 
@@ -80,11 +146,7 @@ int mbediso_closedir(struct mbediso_dir* dir)
     if(!dir)
         return 0;
 
-    if(dir->on_heap)
-    {
-        mbediso_directory_dtor(dir->directory);
-        free(dir->directory);
-    }
+    s_mbediso_release_directory(dir->directory, dir->on_heap);
 
     free(dir);
     return 0;
@@ -92,7 +154,7 @@ int mbediso_closedir(struct mbediso_dir* dir)
 
 const struct mbediso_dirent* mbediso_readdir(struct mbediso_dir* dir)
 {
-    if(dir->entry_index >= dir->directory->entry_count)
+    if(dir->entry_index >= dir->entry_end)
         return NULL;
 
     const struct mbediso_dir_entry* entry = &dir->directory->entries[dir->entry_index];
@@ -119,10 +181,79 @@ const struct mbediso_dirent* mbediso_readdir(struct mbediso_dir* dir)
     return &dir->dirent;
 }
 
+int mbediso_readdir_bulk(struct mbediso_dir* dir, struct mbediso_dirent_info* entries, int max_entries, char* name_buffer, size_t name_buffer_size)
+{
+    uint8_t* const name = dir->dirent.d_name;
+
+    // length of the previous entry's name (entry 0 and restart entries never use it)
+    size_t name_length = 0;
+    if(dir->entry_index > 0)
+    {
+        const uint8_t* name_end = memchr(name, '\0', sizeof(dir->dirent.d_name));
+        if(name_end)
+            name_length = name_end - name;
+    }
+
+    size_t name_buffer_used = 0;
+    int count = 0;
+
+    while(count < max_entries && dir->entry_index < dir->entry_end)
+    {
+        const struct mbediso_dir_entry* entry = &dir->directory->entries[dir->entry_index];
+        const struct mbediso_string_diff* diff = &entry->name_frag;
+
+        if(diff->subst_end >= sizeof(dir->dirent.d_name))
+        {
+            // this should be unreachable
+            return -1;
+        }
+
+        size_t new_name_length = (diff->clip_end || diff->subst_end > name_length) ? diff->subst_end : name_length;
+
+        // leave the entry for the next call
+        if(name_buffer_used + new_name_length + 1 > name_buffer_size)
+            return (count == 0) ? -1 : count;
+
+        // update the entry name
+        const char* diff_str = (const char*)(dir->directory->stringtable + diff->subst_table_offset);
+        for(unsigned i = diff->subst_begin; i < diff->subst_end; ++i)
+            name[i] = *(diff_str++);
+
+        name[new_name_length] = '\0';
+        name_length = new_name_length;
+
+        char* const dest = name_buffer + name_buffer_used;
+        memcpy(dest, name, name_length + 1);
+        name_buffer_used += name_length + 1;
+
+        struct mbediso_dirent_info* const info = &entries[count];
+        info->name = dest;
+        info->name_length = (uint32_t)name_length;
+
+        if(entry->l.directory)
+        {
+            info->d_type = MBEDISO_DT_DIR;
+            info->size = 0;
+            info->id = MBEDISO_INVALID_ID;
+        }
+        else
+        {
+            info->d_type = MBEDISO_DT_REG;
+            info->size = entry->l.length;
+            info->id = MBEDISO_LOCATION_ID(&entry->l);
+        }
+
+        dir->entry_index++;
+        count++;
+    }
+
+    return count;
+}
+
 int mbediso_exists(struct mbediso_fs* fs, const char* name)
 {
     struct mbediso_location loc;
-    if(!mbediso_fs_lookup(fs, name, &loc))
+    if(!mbediso_fs_lookup_noload(fs, name, &loc))
         return 0;
 
     if(loc.directory)
@@ -130,3 +261,615 @@ int mbediso_exists(struct mbediso_fs* fs, const char* name)
     else
         return MBEDISO_DT_REG;
 }
+
+int mbediso_stat(struct mbediso_fs* fs, const char* name, struct mbediso_stat* st)
+{
+    struct mbediso_location loc;
+    if(!mbediso_fs_lookup_noload(fs, name, &loc))
+        return -1;
+
+    if(loc.directory)
+    {
+        st->st_type = MBEDISO_DT_DIR;
+        st->st_size = 0;
+        st->st_offset = -1;
+    }
+    else
+    {
+        st->st_type = MBEDISO_DT_REG;
+        st->st_size = loc.length;
+        st->st_offset = (int64_t)loc.sector * 2048;
+    }
+
+    return 0;
+}
+
+struct mbediso_glob_state
+{
+    struct mbediso_fs* fs;
+    mbediso_path_callback callback;
+    void* userdata;
+
+    char* path;
+    int count;
+    bool stop;
+};
+
+/* advances past separators and `.` segments; returns false on a `..` segment */
+static bool s_mbediso_path_skip_separators(const char** pattern)
+{
+    const char* p = *pattern;
+
+    while(true)
+    {
+        if(*p == '/')
+            p++;
+        else if(p[0] == '.' && (p[1] == '/' || p[1] == '\0'))
+            p++;
+        else if(p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+            return false;
+        else
+            break;
+    }
+
+    *pattern = p;
+    return true;
+}
+
+static void s_mbediso_glob_directory(struct mbediso_glob_state* state, struct mbediso_directory* directory, bool on_heap, uint32_t directory_index, const char* pattern, size_t path_length)
+{
+    const char* segment_end = pattern;
+    while(*segment_end != '/' && *segment_end != '\0')
+        segment_end++;
+
+    const size_t segment_length = segment_end - pattern;
+
+    // already validated by mbediso_glob
+    const char* next_segment = segment_end;
+    s_mbediso_path_skip_separators(&next_segment);
+
+    const bool last_segment = (*next_segment == '\0');
+
+    // restrict the search to the entries sharing the literal prefix of the segment
+    const size_t literal_length = mbediso_util_wildcard_prefix((const uint8_t*)pattern, segment_length);
+
+    uint32_t begin, end;
+    struct mbediso_name name;
+    uint32_t name_length = 0;
+
+    if(literal_length == segment_length)
+    {
+        struct mbediso_location* loc;
+        if(!mbediso_directory_lookup(directory, pattern, segment_length, &loc))
+            return;
+
+        begin = (uint32_t)((const struct mbediso_dir_entry*)((const uint8_t*)loc - offsetof(struct mbediso_dir_entry, l)) - directory->entries);
+        end = begin + 1;
+    }
+    else
+    {
+        mbediso_directory_prefix_range(directory, pattern, literal_length, &begin, &end);
+
+        if(begin > 0 && begin < end)
+        {
+            int prev_length = mbediso_directory_get_name(directory, begin - 1, &name);
+            if(prev_length < 0)
+                return;
+
+            name_length = prev_length;
+        }
+    }
+
+    for(uint32_t i = begin; i < end && !state->stop; i++)
+    {
+        // the previous callback may have moved the directory
+        directory = s_mbediso_refresh_directory(state->fs, directory, on_heap, directory_index);
+
+        const struct mbediso_dir_entry* entry = &directory->entries[i];
+
+        if(literal_length == segment_length)
+        {
+            memcpy(name.buffer, pattern, segment_length);
+            name_length = segment_length;
+        }
+        else
+        {
+            mbediso_directory_next_name(directory, i, &name, &name_length);
+
+            if(!mbediso_util_wildcard_match((const uint8_t*)pattern, segment_length, name.buffer, name_length))
+                continue;
+        }
+
+        if(!last_segment && !entry->l.directory)
+            continue;
+
+        // append the name to the path
+        size_t new_path_length = path_length + (path_length != 0) + name_length;
+        if(new_path_length + 1 > MBEDISO_PATH_CAPACITY)
+            continue;
+
+        if(path_length != 0)
+            state->path[path_length] = '/';
+
+        memcpy(state->path + new_path_length - name_length, name.buffer, name_length);
+        state->path[new_path_length] = '\0';
+
+        if(last_segment)
+        {
+            state->count++;
+
+            if(state->callback(state->userdata, state->path, entry->l.directory ? MBEDISO_DT_DIR : MBEDISO_DT_REG, entry->l.directory ? 0 : entry->l.length))
+                state->stop = true;
+
+            continue;
+        }
+
+        bool child_on_heap = false;
+        uint32_t child_index = entry->l.sector;
+        struct mbediso_directory* child = s_mbediso_acquire_directory(state->fs, &entry->l, &child_on_heap);
+        if(!child)
+            continue;
+
+        s_mbediso_glob_directory(state, child, child_on_heap, child_index, next_segment, new_path_length);
+
+        s_mbediso_release_directory(s_mbediso_refresh_directory(state->fs, child, child_on_heap, child_index), child_on_heap);
+    }
+}
+
+int mbediso_glob(struct mbediso_fs* fs, const char* pattern, mbediso_path_callback callback, void* userdata)
+{
+    if(!fs || !pattern || !callback)
+        return -1;
+
+    // validate the pattern and find the segments without wildcards at its start
+    const char* p = pattern;
+    const char* literal_end = NULL;
+    int segment_count = 0;
+
+    while(true)
+    {
+        if(!s_mbediso_path_skip_separators(&p))
+            return -1;
+
+        if(*p == '\0')
+            break;
+
+        const char* segment_end = p;
+        while(*segment_end != '/' && *segment_end != '\0')
+            segment_end++;
+
+        if(!literal_end && mbediso_util_wildcard_prefix((const uint8_t*)p, segment_end - p) != (size_t)(segment_end - p))
+            literal_end = p;
+
+        if(++segment_count > 16)
+            return -1;
+
+        p = segment_end;
+    }
+
+    // nothing to match
+    if(segment_count == 0)
+        return 0;
+
+    struct mbediso_glob_state state;
+    state.fs = fs;
+    state.callback = callback;
+    state.userdata = userdata;
+    state.count = 0;
+    state.stop = false;
+
+    state.path = malloc(MBEDISO_PATH_CAPACITY);
+    if(!state.path)
+        return -1;
+
+    // resolve the literal directories through the usual lookup, which caches them; the final segment is always matched by the glob
+    size_t base_length = 0;
+    const char* glob_start = pattern;
+    s_mbediso_path_skip_separators(&glob_start);
+
+    while(true)
+    {
+        const char* segment_end = glob_start;
+        while(*segment_end != '/' && *segment_end != '\0')
+            segment_end++;
+
+        const char* next_segment = segment_end;
+        s_mbediso_path_skip_separators(&next_segment);
+
+        if(glob_start == literal_end || *next_segment == '\0')
+            break;
+
+        if(base_length != 0)
+            state.path[base_length++] = '/';
+
+        memcpy(state.path + base_length, glob_start, segment_end - glob_start);
+        base_length += segment_end - glob_start;
+
+        glob_start = next_segment;
+    }
+
+    state.path[base_length] = '\0';
+
+    struct mbediso_location loc;
+    bool on_heap = false;
+    struct mbediso_directory* directory = NULL;
+
+    if(mbediso_fs_lookup(fs, state.path, &loc))
+        directory = s_mbediso_acquire_directory(fs, &loc, &on_heap);
+
+    if(directory)
+    {
+        s_mbediso_glob_directory(&state, directory, on_heap, loc.sector, glob_start, base_length);
+        s_mbediso_release_directory(directory, on_heap);
+    }
+
+    free(state.path);
+
+    return state.count;
+}
+
+struct mbediso_walk_frame
+{
+    struct mbediso_directory* directory;
+    bool on_heap;
+    uint32_t directory_index;
+    uint32_t entry_index;
+    uint32_t name_length;
+    size_t path_length;
+    struct mbediso_name name;
+};
+
+int mbediso_walk(struct mbediso_fs* fs, const char* root, mbediso_path_callback callback, void* userdata)
+{
+    if(!fs || !root || !callback)
+        return -1;
+
+    char* path = malloc(MBEDISO_PATH_CAPACITY);
+    struct mbediso_walk_frame* stack = malloc(16 * sizeof(struct mbediso_walk_frame));
+
+    if(!path || !stack)
+    {
+        free(path);
+        free(stack);
+        return -1;
+    }
+
+    // normalize the root path, since it begins every reported path
+    size_t path_length = 0;
+    int depth = 0;
+    bool valid = true;
+
+    const char* p = root;
+
+    while(true)
+    {
+        if(!s_mbediso_path_skip_separators(&p))
+        {
+            valid = false;
+            break;
+        }
+
+        if(*p == '\0')
+            break;
+
+        const char* segment_end = p;
+        while(*segment_end != '/' && *segment_end != '\0')
+            segment_end++;
+
+        if(++depth > 16 || path_length + 1 + (segment_end - p) + 1 > MBEDISO_PATH_CAPACITY)
+        {
+            valid = false;
+            break;
+        }
+
+        if(path_length != 0)
+            path[path_length++] = '/';
+
+        memcpy(path + path_length, p, segment_end - p);
+        path_length += segment_end - p;
+
+        p = segment_end;
+    }
+
+    path[path_length] = '\0';
+
+    struct mbediso_location loc;
+
+    if(valid && mbediso_fs_lookup(fs, path, &loc))
+    {
+        stack[0].directory = s_mbediso_acquire_directory(fs, &loc, &stack[0].on_heap);
+        stack[0].directory_index = loc.sector;
+    }
+    else
+        stack[0].directory = NULL;
+
+    if(!stack[0].directory)
+    {
+        free(path);
+        free(stack);
+        return -1;
+    }
+
+    stack[0].entry_index = 0;
+    stack[0].name_length = 0;
+    stack[0].path_length = path_length;
+
+    int stack_level = 0;
+    int count = 0;
+
+    while(stack_level >= 0)
+    {
+        struct mbediso_walk_frame* const cur_frame = &stack[stack_level];
+
+        // a callback may have moved the directory
+        cur_frame->directory = s_mbediso_refresh_directory(fs, cur_frame->directory, cur_frame->on_heap, cur_frame->directory_index);
+
+        // done with this directory
+        if(cur_frame->entry_index >= cur_frame->directory->entry_count)
+        {
+            s_mbediso_release_directory(cur_frame->directory, cur_frame->on_heap);
+            stack_level--;
+            continue;
+        }
+
+        const struct mbediso_dir_entry* cur_entry = &cur_frame->directory->entries[cur_frame->entry_index];
+        mbediso_directory_next_name(cur_frame->directory, cur_frame->entry_index, &cur_frame->name, &cur_frame->name_length);
+        cur_frame->entry_index++;
+
+        // append the name to the directory's path
+        size_t new_path_length = cur_frame->path_length + (cur_frame->path_length != 0) + cur_frame->name_length;
+        if(new_path_length + 1 > MBEDISO_PATH_CAPACITY)
+            continue;
+
+        if(cur_frame->path_length != 0)
+            path[cur_frame->path_length] = '/';
+
+        memcpy(path + new_path_length - cur_frame->name_length, cur_frame->name.buffer, cur_frame->name_length);
+        path[new_path_length] = '\0';
+
+        count++;
+
+        int ret = callback(userdata, path, cur_entry->l.directory ? MBEDISO_DT_DIR : MBEDISO_DT_REG, cur_entry->l.directory ? 0 : cur_entry->l.length);
+
+        cur_frame->directory = s_mbediso_refresh_directory(fs, cur_frame->directory, cur_frame->on_heap, cur_frame->directory_index);
+        cur_entry = &cur_frame->directory->entries[cur_frame->entry_index - 1];
+
+        if(ret == MBEDISO_WALK_SKIP)
+            continue;
+
+        if(ret != 0)
+        {
+            // stop: release every open directory
+            for(; stack_level >= 0; stack_level--)
+                s_mbediso_release_directory(stack[stack_level].directory, stack[stack_level].on_heap);
+
+            break;
+        }
+
+        // paths deeper than 16 segments cannot be represented
+        if(!cur_entry->l.directory || depth + stack_level + 1 >= 16)
+            continue;
+
+        struct mbediso_walk_frame* const new_frame = &stack[stack_level + 1];
+
+        new_frame->directory = s_mbediso_acquire_directory(fs, &cur_entry->l, &new_frame->on_heap);
+        if(!new_frame->directory)
+            continue;
+
+        new_frame->directory_index = cur_entry->l.sector;
+        new_frame->entry_index = 0;
+        new_frame->name_length = 0;
+        new_frame->path_length = new_path_length;
+
+        stack_level++;
+    }
+
+    free(path);
+    free(stack);
+
+    return count;
+}
+
+/* walkers check whether another has stopped the walk after this many paths, rather than locking for every path */
+static const uint32_t c_walk_stop_check_interval = 64;
+
+struct mbediso_walk_parallel_state
+{
+    struct mbediso_fs* fs;
+    mbediso_path_callback callback;
+    void* userdata;
+
+    /* the directories directly below the root, walked one at a time by each walker */
+    char** subtrees;
+    int subtree_count;
+    int subtree_capacity;
+    int next_subtree;
+
+    int count;
+    bool stop;
+    bool failed;
+
+    /* guards next_subtree, count, and stop */
+    mbediso_mutex_t mutex;
+};
+
+/* one walker's view of a parallel walk, passed to mbediso_walk as userdata */
+struct mbediso_walk_walker
+{
+    struct mbediso_walk_parallel_state* state;
+    int count;
+};
+
+/* records each directory below the root as a subtree for the walkers, reporting every entry to the user callback on the way */
+static int s_mbediso_walk_collect(void* userdata, const char* path, int d_type, int64_t size)
+{
+    struct mbediso_walk_parallel_state* state = (struct mbediso_walk_parallel_state*)userdata;
+
+    state->count++;
+
+    int ret = state->callback(state->userdata, path, d_type, size);
+    if(ret != 0)
+    {
+        if(ret != MBEDISO_WALK_SKIP)
+            state->stop = true;
+
+        return ret;
+    }
+
+    if(d_type != MBEDISO_DT_DIR)
+        return 0;
+
+    if(state->subtree_count == state->subtree_capacity)
+    {
+        int new_capacity = (state->subtree_capacity) ? state->subtree_capacity * 2 : 16;
+        char** new_subtrees = realloc(state->subtrees, new_capacity * sizeof(char*));
+        if(!new_subtrees)
+        {
+            state->failed = true;
+            return 1;
+        }
+
+        state->subtrees = new_subtrees;
+        state->subtree_capacity = new_capacity;
+    }
+
+    size_t path_length = strlen(path);
+    char* subtree = malloc(path_length + 1);
+    if(!subtree)
+    {
+        state->failed = true;
+        return 1;
+    }
+
+    memcpy(subtree, path, path_length + 1);
+    state->subtrees[state->subtree_count++] = subtree;
+
+    // walked later, by one of the walkers
+    return MBEDISO_WALK_SKIP;
+}
+
+static int s_mbediso_walk_forward(void* userdata, const char* path, int d_type, int64_t size)
+{
+    struct mbediso_walk_walker* walker = (struct mbediso_walk_walker*)userdata;
+    struct mbediso_walk_parallel_state* state = walker->state;
+
+    if(((uint32_t)walker->count + 1) % c_walk_stop_check_interval == 0)
+    {
+        mbediso_mutex_lock(state->mutex);
+        bool stop = state->stop;
+        mbediso_mutex_unlock(state->mutex);
+
+        if(stop)
+            return 1;
+    }
+
+    walker->count++;
+
+    int ret = state->callback(state->userdata, path, d_type, size);
+    if(ret != 0 && ret != MBEDISO_WALK_SKIP)
+    {
+        mbediso_mutex_lock(state->mutex);
+        state->stop = true;
+        mbediso_mutex_unlock(state->mutex);
+    }
+
+    return ret;
+}
+
+static int s_mbediso_walk_walker(void* data)
+{
+    struct mbediso_walk_parallel_state* state = (struct mbediso_walk_parallel_state*)data;
+
+    struct mbediso_walk_walker walker;
+    walker.state = state;
+    walker.count = 0;
+
+    mbediso_mutex_lock(state->mutex);
+
+    while(!state->stop && state->next_subtree < state->subtree_count)
+    {
+        const char* subtree = state->subtrees[state->next_subtree++];
+
+        mbediso_mutex_unlock(state->mutex);
+        mbediso_walk(state->fs, subtree, s_mbediso_walk_forward, &walker);
+        mbediso_mutex_lock(state->mutex);
+    }
+
+    state->count += walker.count;
+
+    mbediso_mutex_unlock(state->mutex);
+
+    return 0;
+}
+
+int mbediso_walk_parallel(struct mbediso_fs* fs, const char* root, mbediso_path_callback callback, void* userdata, int threads)
+{
+    if(!fs || !root || !callback)
+        return -1;
+
+    // walkers share fs->directories without locking, which is only safe once no lookup can load another directory
+    if(mbediso_scanfs(fs) != 0)
+        return -1;
+
+    struct mbediso_walk_parallel_state state;
+    state.fs = fs;
+    state.callback = callback;
+    state.userdata = userdata;
+    state.subtrees = NULL;
+    state.subtree_count = 0;
+    state.subtree_capacity = 0;
+    state.next_subtree = 0;
+    state.count = 0;
+    state.stop = false;
+    state.failed = false;
+
+    // report the entries directly below the root on this thread, collecting the subtrees
+    if(mbediso_walk(fs, root, s_mbediso_walk_collect, &state) < 0)
+    {
+        free(state.subtrees);
+        return -1;
+    }
+
+    state.mutex = mbediso_mutex_alloc();
+
+    if(threads < 1)
+        threads = 1;
+
+    if(threads > state.subtree_count)
+        threads = state.subtree_count;
+
+    mbediso_thread_t* workers = (threads > 1) ? malloc((threads - 1) * sizeof(mbediso_thread_t)) : NULL;
+    int worker_count = 0;
+
+    if(!state.mutex)
+        state.failed = true;
+    else if(!state.failed && !state.stop)
+    {
+        // this thread walks too; without thread support, it walks every subtree itself
+        for(int i = 0; workers && i < threads - 1; i++)
+        {
+            mbediso_thread_t worker = mbediso_thread_create(s_mbediso_walk_walker, &state);
+            if(!worker)
+                break;
+
+            workers[worker_count++] = worker;
+        }
+
+        s_mbediso_walk_walker(&state);
+
+        for(int i = 0; i < worker_count; i++)
+            mbediso_thread_join(workers[i]);
+    }
+
+    free(workers);
+
+    for(int i = 0; i < state.subtree_count; i++)
+        free(state.subtrees[i]);
+
+    free(state.subtrees);
+
+    if(state.mutex)
+        mbediso_mutex_free(state.mutex);
+
+    return (state.failed) ? -1 : state.count;
+}
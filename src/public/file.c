@@ -23,6 +23,22 @@
 #include "mbediso/file.h"
 #include "internal/io.h"
 #include "internal/fs.h"
+#include "internal/async.h"
+
+static struct mbediso_file* s_mbediso_fopen_location(struct mbediso_fs* fs, const struct mbediso_location* loc)
+{
+    struct mbediso_file* f = malloc(sizeof(struct mbediso_file));
+
+    if(!f)
+        return NULL;
+
+    f->fs = fs;
+    f->start = loc->sector * 2048;
+    f->end = f->start + loc->length;
+    f->offset = 0;
+
+    return f;
+}
 
 struct mbediso_file* mbediso_fopen(struct mbediso_fs* fs, const char* filename)
 {
@@ -33,42 +49,100 @@ struct mbediso_file* mbediso_fopen(struct mbediso_fs* fs, const char* filename)
     if(loc.directory)
         return NULL;
 
-    struct mbediso_io* io = mbediso_fs_reserve_io(fs);
+    return s_mbediso_fopen_location(fs, &loc);
+}
 
-    if(!io)
+uint64_t mbediso_lookup_id(struct mbediso_fs* fs, const char* pathname)
+{
+    struct mbediso_location loc;
+    if(!mbediso_fs_lookup(fs, pathname, &loc))
+        return MBEDISO_INVALID_ID;
+
+    if(loc.directory)
+        return MBEDISO_INVALID_ID;
+
+    return MBEDISO_LOCATION_ID(&loc);
+}
+
+struct mbediso_file* mbediso_fopen_id(struct mbediso_fs* fs, uint64_t id)
+{
+    struct mbediso_location loc;
+    loc.sector = (uint32_t)(id >> 32);
+    loc.length = (uint32_t)id;
+    loc.directory = false;
+
+    // the file's byte range must be representable
+    if(id == MBEDISO_INVALID_ID || loc.sector > (UINT32_MAX - loc.length) / 2048)
         return NULL;
 
-    struct mbediso_file* f = malloc(sizeof(struct mbediso_file));
+    return s_mbediso_fopen_location(fs, &loc);
+}
 
-    if(!f)
+void* mbediso_load(struct mbediso_fs* fs, const char* pathname, size_t* size, const struct mbediso_allocator* allocator)
+{
+    struct mbediso_location loc;
+    if(!mbediso_fs_lookup(fs, pathname, &loc))
+        return NULL;
+
+    if(loc.directory || loc.sector > (UINT32_MAX - loc.length) / 2048)
+        return NULL;
+
+    // allocate at least one byte so that empty files succeed
+    size_t alloc_size = (loc.length != 0) ? loc.length : 1;
+    uint8_t* data = (allocator) ? allocator->alloc(allocator->userdata, alloc_size) : malloc(alloc_size);
+
+    if(!data)
+        return NULL;
+
+    struct mbediso_io* io = mbediso_fs_reserve_io(fs);
+    size_t got = 0;
+
+    if(io)
+        got = mbediso_io_read_direct(io, data, (uint64_t)loc.sector * 2048, loc.length);
+
+    mbediso_fs_release_io(fs, io);
+
+    if(!io || got != loc.length)
     {
-        mbediso_fs_release_io(fs, io);
+        if(allocator)
+            allocator->free(allocator->userdata, data);
+        else
+            free(data);
+
         return NULL;
     }
 
-    f->io = io;
-    f->fs = fs;
-    f->start = loc.sector * 2048;
-    f->end = f->start + loc.length;
-    f->offset = 0;
-
-    return f;
+    *size = loc.length;
+    return data;
 }
 
-size_t mbediso_fread(struct mbediso_file* file, void* ptr, size_t size, size_t maxnum)
+/* reads up to bytes from offset within the file, without touching the file's state */
+static size_t s_mbediso_file_read(const struct mbediso_file* file, void* ptr, size_t bytes, uint32_t offset)
 {
-    size_t bytes = size * maxnum;
+    if(offset >= file->end - file->start)
+        return 0;
 
-    if(file->offset >= file->end - file->start)
+    if(bytes > file->end - (file->start + offset))
+        bytes = file->end - (file->start + offset);
+
+    // borrow an IO only for the duration of the read, so that idle handles hold no IO resources
+    struct mbediso_io* io = mbediso_fs_reserve_io(file->fs);
+    if(!io)
         return 0;
 
+    size_t ret = mbediso_io_read_direct(io, ptr, offset + file->start, bytes);
+
+    mbediso_fs_release_io(file->fs, io);
+
+    return ret;
+}
+
+size_t mbediso_fread(struct mbediso_file* file, void* ptr, size_t size, size_t maxnum)
+{
     if(size * maxnum == 0)
         return 0;
 
-    if(bytes > file->end - (file->start + file->offset))
-        bytes = file->end - (file->start + file->offset);
-
-    size_t ret = mbediso_io_read_direct(file->io, ptr, file->offset + file->start, bytes);
+    size_t ret = s_mbediso_file_read(file, ptr, size * maxnum, file->offset);
     // ignore incompletely-read members
     ret -= ret % size;
     file->offset += ret;
@@ -76,6 +150,174 @@ size_t mbediso_fread(struct mbediso_file* file, void* ptr, size_t size, size_t m
     return ret / size;
 }
 
+size_t mbediso_freadv(struct mbediso_file* file, const struct mbediso_iovec* iov, int iovcnt)
+{
+    if(iovcnt <= 0 || file->offset >= file->end - file->start)
+        return 0;
+
+    struct mbediso_io* io = mbediso_fs_reserve_io(file->fs);
+    if(!io)
+        return 0;
+
+    size_t total = 0;
+
+    for(int i = 0; i < iovcnt; i++)
+    {
+        // empty buffers are skipped, not treated as the end of the file
+        if(iov[i].length == 0)
+            continue;
+
+        size_t bytes = iov[i].length;
+        if(bytes > file->end - (file->start + file->offset))
+            bytes = file->end - (file->start + file->offset);
+
+        if(bytes == 0)
+            break;
+
+        // the io's cached block carries over between consecutive buffers
+        size_t ret = mbediso_io_read_direct(io, iov[i].base, file->offset + file->start, bytes);
+        file->offset += ret;
+        total += ret;
+
+        if(ret != iov[i].length)
+            break;
+    }
+
+    mbediso_fs_release_io(file->fs, io);
+
+    return total;
+}
+
+size_t mbediso_pread(struct mbediso_file* file, void* ptr, size_t bytes, int64_t offset)
+{
+    if(bytes == 0 || offset < 0 || offset >= file->end - file->start)
+        return 0;
+
+    return s_mbediso_file_read(file, ptr, bytes, (uint32_t)offset);
+}
+
+int mbediso_read_async(struct mbediso_file* file, int64_t offset, void* buffer, size_t length, mbediso_read_callback callback, void* userdata)
+{
+    return mbediso_read_async_priority(file, offset, buffer, length, MBEDISO_PRIORITY_FOREGROUND, callback, userdata);
+}
+
+int mbediso_read_async_priority(struct mbediso_file* file, int64_t offset, void* buffer, size_t length, int priority, mbediso_read_callback callback, void* userdata)
+{
+    if(offset < 0 || offset > file->end - file->start || priority < 0 || priority >= MBEDISO_PRIORITY_COUNT)
+        return -1;
+
+    struct mbediso_async* async = mbediso_fs_get_async(file->fs);
+    if(!async)
+        return -1;
+
+    struct mbediso_async_request* request = malloc(sizeof(struct mbediso_async_request));
+    if(!request)
+        return -1;
+
+    if(length > (size_t)((file->end - file->start) - offset))
+        length = (size_t)((file->end - file->start) - offset);
+
+    request->offset = file->start + (uint64_t)offset;
+    request->length = length;
+    request->buffer = buffer;
+    request->priority = priority;
+    request->callback = callback;
+    request->userdata = userdata;
+
+    mbediso_async_submit(async, request);
+
+    return 0;
+}
+
+int mbediso_poll_completions(struct mbediso_fs* fs, struct mbediso_completion* out, int max_completions)
+{
+    // nothing can be pending before the first async read, so don't start the workers here
+    struct mbediso_async* async = mbediso_fs_find_async(fs);
+    if(!async)
+        return 0;
+
+    return mbediso_async_poll(async, out, max_completions);
+}
+
+int mbediso_completion_fd(struct mbediso_fs* fs)
+{
+    struct mbediso_async* async = mbediso_fs_find_async(fs);
+    if(!async)
+        return -1;
+
+    return async->event_fd;
+}
+
+const struct mbediso_view* mbediso_fmap(struct mbediso_file* file, int64_t offset, size_t length)
+{
+    if(offset < 0 || length == 0 || offset > file->end - file->start || length > (size_t)((file->end - file->start) - offset))
+        return NULL;
+
+    struct mbediso_view* view = malloc(sizeof(struct mbediso_view));
+    if(!view)
+        return NULL;
+
+    view->length = length;
+    view->fs = file->fs;
+    view->map_base = NULL;
+    view->map_length = 0;
+    view->pinned_io = NULL;
+    view->buffer = NULL;
+
+    uint64_t archive_offset = file->start + (uint64_t)offset;
+
+    struct mbediso_io* io = mbediso_fs_reserve_io(file->fs);
+    if(!io)
+    {
+        free(view);
+        return NULL;
+    }
+
+    // uncompressed archive: map the range directly
+    view->data = mbediso_io_map(io, archive_offset, length, &view->map_base, &view->map_length);
+    if(view->data)
+    {
+        mbediso_fs_release_io(file->fs, io);
+        return view;
+    }
+
+    // range within a single LZ4 block: keep the IO reserved so its block stays put
+    view->data = mbediso_io_read_block_view(io, archive_offset, length);
+    if(view->data)
+    {
+        view->pinned_io = io;
+        return view;
+    }
+
+    // otherwise, read into a new buffer
+    view->buffer = malloc(length);
+
+    if(view->buffer && mbediso_io_read_direct(io, view->buffer, archive_offset, length) == length)
+    {
+        mbediso_fs_release_io(file->fs, io);
+        view->data = view->buffer;
+        return view;
+    }
+
+    mbediso_fs_release_io(file->fs, io);
+    free(view->buffer);
+    free(view);
+    return NULL;
+}
+
+void mbediso_funmap(const struct mbediso_view* view)
+{
+    if(!view)
+        return;
+
+    struct mbediso_view* v = (struct mbediso_view*)view;
+
+    mbediso_io_unmap(v->map_base, v->map_length);
+    mbediso_fs_release_io(v->fs, v->pinned_io);
+    free(v->buffer);
+    free(v);
+}
+
 int64_t mbediso_fseek(struct mbediso_file* file, int64_t offset, int whence)
 {
     int64_t try_offset = -1;
@@ -101,7 +343,6 @@ int64_t mbediso_fsize(struct mbediso_file* file)
 
 void mbediso_fclose(struct mbediso_file* file)
 {
-    mbediso_fs_release_io(file->fs, file->io);
     free(file);
 }
 
@@ -109,3 +350,12 @@ struct mbediso_fs* mbediso_file_fs(struct mbediso_file* file)
 {
     return file->fs;
 }
+
+uint64_t mbediso_file_id(struct mbediso_file* file)
+{
+    struct mbediso_location loc;
+    loc.sector = file->start / 2048;
+    loc.length = file->end - file->start;
+
+    return MBEDISO_LOCATION_ID(&loc);
+}
@@ -24,6 +24,7 @@
 #include "internal/io.h"
 #include "internal/fs.h"
 #include "internal/read.h"
+#include "internal/profile.h"
 
 struct mbediso_fs* mbediso_openfs_file(const char* name, bool full_scan)
 {
@@ -93,3 +94,54 @@ void mbediso_closefs(struct mbediso_fs* fs)
     mbediso_fs_dtor(fs);
     free(fs);
 }
+
+void mbediso_get_stats(struct mbediso_fs* fs, struct mbediso_stats* stats, bool reset)
+{
+    if(!fs || !stats)
+        return;
+
+    mbediso_fs_get_stats(fs, stats, reset);
+}
+
+void mbediso_set_read_ahead(struct mbediso_fs* fs, uint32_t bytes)
+{
+    if(!fs)
+        return;
+
+    mbediso_fs_set_read_ahead(fs, bytes);
+}
+
+int mbediso_record_profile(struct mbediso_fs* fs)
+{
+    if(!fs)
+        return -1;
+
+    return mbediso_fs_record_profile(fs);
+}
+
+int mbediso_save_profile(struct mbediso_fs* fs, const char* filename)
+{
+    if(!fs || !fs->profile)
+        return -1;
+
+    return mbediso_profile_save(fs->profile, filename);
+}
+
+int mbediso_replay_profile(struct mbediso_fs* fs, const char* filename)
+{
+    if(!fs)
+        return -1;
+
+    struct mbediso_profile profile;
+    if(!mbediso_profile_ctor(&profile))
+        return -1;
+
+    int ret = -1;
+
+    if(mbediso_profile_load(&profile, filename) == 0)
+        ret = mbediso_fs_replay_profile(fs, &profile);
+
+    mbediso_profile_dtor(&profile);
+
+    return ret;
+}
@@ -19,11 +19,55 @@
 
 #include <cstddef>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 namespace LZ4Pack
 {
 
+struct Options
+{
+    size_t block_size = 4*1024;
+    bool big_endian = false;
+
+    // number of compression threads, or 0 for one per hardware thread; the output does not depend on the thread count
+    unsigned threads = 0;
+
+    // try the fast compressor first, escalating through the HC levels only while doing so still shrinks the block noticeably
+    bool adaptive = false;
+
+    // try the fast compressor before HC, storing blocks which it finds far from compressible without spending HC time on them
+    bool precheck = true;
+
+    // blocks that compress to more than this percentage of their size are stored uncompressed, trading bytes read for decode time
+    unsigned stored_threshold = 50;
+
+    // if nonzero, the storage read speed in MB/s: blocks are then stored wherever reading the bytes that compression saves takes less time than decoding the block at decode_mbps, in place of stored_threshold
+    unsigned read_mbps = 0;
+
+    // LZ4 decode speed in MB/s of output, for read_mbps
+    unsigned decode_mbps = 2000;
+
+    // if set, a previous archive of the same block size: blocks whose content it already holds are copied from it instead of compressed
+    FILE* previous = nullptr;
+
+    // read the input until its end and write the output sequentially, so that either may be a pipe; the block index then follows the data, in a final skippable frame
+    bool streaming = false;
+};
+
 // compress a file into an mbediso-compatible indexed LZ4 archive
-bool compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian);
+bool compress(FILE* outf, FILE* inf, const Options& options);
+
+// compress a file into an mbediso-compatible indexed LZ4 archive, using up to threads threads (0 for one per hardware thread)
+bool compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian, unsigned threads = 0);
+
+// index an archive made by the lz4 tool (a single frame of independent blocks, each holding the full block size except the last) by appending the block offset table as a final skippable frame, so that mbediso need not decode its blocks at each open; the lz4 tool still decompresses it
+bool append_index(FILE* archive);
+
+// build a Joliet ISO of a directory tree, with all directory records at the front, followed by the files listed in file_order (paths relative to root_dir, using '/'), and then all other files in directory order
+bool build_iso(FILE* outf, const char* root_dir, const std::vector<std::string>& file_order);
+
+// load a list of paths, one per line (such as the files touched by an application, in first-access order)
+bool load_path_list(std::vector<std::string>& out, const char* filename);
 
 }
@@ -0,0 +1,614 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+
+#include "lz4_pack.h"
+
+namespace fs = std::filesystem;
+
+static constexpr uint32_t sector_size = 2048;
+
+// Joliet allows 64 characters, but longer names (up to 103) are widely supported and fit in a directory record
+static constexpr size_t max_name_units = 103;
+
+struct IsoNode
+{
+    std::string name;
+    std::u16string name16;
+    fs::path path;
+    std::string iso_path;
+    bool is_dir = false;
+    bool placed = false;
+
+    uint32_t sector = 0;
+    uint32_t length = 0;
+
+    // directories only
+    std::vector<IsoNode> children;
+    uint16_t dir_number = 0;
+    uint16_t parent_number = 0;
+};
+
+static bool utf8_to_utf16(std::u16string& out, const std::string& in)
+{
+    out.clear();
+
+    size_t i = 0;
+    while(i < in.size())
+    {
+        uint8_t c = (uint8_t)in[i];
+        uint32_t codepoint;
+        size_t extra;
+
+        if(c < 0x80)
+        {
+            codepoint = c;
+            extra = 0;
+        }
+        else if((c & 0xE0) == 0xC0)
+        {
+            codepoint = c & 0x1F;
+            extra = 1;
+        }
+        else if((c & 0xF0) == 0xE0)
+        {
+            codepoint = c & 0x0F;
+            extra = 2;
+        }
+        else if((c & 0xF8) == 0xF0)
+        {
+            codepoint = c & 0x07;
+            extra = 3;
+        }
+        else
+            return false;
+
+        if(extra > in.size() - i - 1)
+            return false;
+
+        for(size_t j = 1; j <= extra; j++)
+        {
+            uint8_t cont = (uint8_t)in[i + j];
+            if((cont & 0xC0) != 0x80)
+                return false;
+
+            codepoint = (codepoint << 6) | (cont & 0x3F);
+        }
+
+        i += 1 + extra;
+
+        if(codepoint >= 0xD800 && codepoint < 0xE000)
+            return false;
+
+        if(codepoint >= 0x10000)
+        {
+            if(codepoint > 0x10FFFF)
+                return false;
+
+            codepoint -= 0x10000;
+            out.push_back((char16_t)(0xD800 + (codepoint >> 10)));
+            out.push_back((char16_t)(0xDC00 + (codepoint & 0x3FF)));
+        }
+        else
+            out.push_back((char16_t)codepoint);
+    }
+
+    return true;
+}
+
+static bool scan_directory(IsoNode& dir)
+{
+    std::error_code ec;
+
+    for(const auto& entry : fs::directory_iterator(dir.path, ec))
+    {
+        IsoNode child;
+        child.path = entry.path();
+        child.name = child.path.filename().u8string();
+        child.iso_path = dir.iso_path.empty() ? child.name : dir.iso_path + "/" + child.name;
+        child.is_dir = entry.is_directory(ec);
+
+        // is_directory follows links, so a symlinked directory could lead back up the tree
+        if(child.is_dir && entry.is_symlink(ec))
+        {
+            fprintf(stderr, "Skipping symlinked directory: %s\n", child.path.u8string().c_str());
+            continue;
+        }
+
+        if(!child.is_dir && !entry.is_regular_file(ec))
+            continue;
+
+        if(!utf8_to_utf16(child.name16, child.name) || child.name16.empty() || child.name16.size() > max_name_units)
+        {
+            fprintf(stderr, "Unsupported name: %s\n", child.path.u8string().c_str());
+            return false;
+        }
+
+        if(!child.is_dir)
+        {
+            uintmax_t size = entry.file_size(ec);
+            if(ec || size > UINT32_MAX)
+            {
+                fprintf(stderr, "Unsupported file: %s\n", child.path.u8string().c_str());
+                return false;
+            }
+
+            child.length = (uint32_t)size;
+        }
+
+        dir.children.push_back(std::move(child));
+    }
+
+    if(ec)
+        return false;
+
+    // Joliet orders entries by their UCS-2 names
+    std::sort(dir.children.begin(), dir.children.end(), [](const IsoNode& a, const IsoNode& b) { return a.name16 < b.name16; });
+
+    for(auto& child : dir.children)
+    {
+        if(child.is_dir && !scan_directory(child))
+            return false;
+    }
+
+    return true;
+}
+
+static void write_both16(uint8_t* dest, uint16_t value)
+{
+    dest[0] = (uint8_t)(value >> 0);
+    dest[1] = (uint8_t)(value >> 8);
+    dest[2] = (uint8_t)(value >> 8);
+    dest[3] = (uint8_t)(value >> 0);
+}
+
+static void write_both32(uint8_t* dest, uint32_t value)
+{
+    for(int i = 0; i < 4; i++)
+    {
+        dest[i] = (uint8_t)(value >> (8 * i));
+        dest[7 - i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static size_t record_length(size_t name_bytes)
+{
+    return 33 + name_bytes + ((name_bytes % 2 == 0) ? 1 : 0);
+}
+
+// append a directory record, moving to the next sector if it would cross a sector boundary
+static void append_record(std::vector<uint8_t>& extent, const uint8_t* name, size_t name_bytes, uint32_t sector, uint32_t length, bool is_dir)
+{
+    size_t rec_length = record_length(name_bytes);
+
+    size_t used = extent.size() % sector_size;
+    if(used + rec_length > sector_size)
+        extent.resize(extent.size() + (sector_size - used), 0);
+
+    size_t pos = extent.size();
+    extent.resize(pos + rec_length, 0);
+
+    uint8_t* rec = &extent[pos];
+    rec[0] = (uint8_t)rec_length;
+    write_both32(rec + 2, sector);
+    write_both32(rec + 10, length);
+    rec[25] = is_dir ? 2 : 0;
+    write_both16(rec + 28, 1);
+    rec[32] = (uint8_t)name_bytes;
+    memcpy(rec + 33, name, name_bytes);
+}
+
+static void name_to_ucs2be(std::vector<uint8_t>& out, const std::u16string& name)
+{
+    out.clear();
+    for(char16_t c : name)
+    {
+        out.push_back((uint8_t)(c >> 8));
+        out.push_back((uint8_t)(c & 0xFF));
+    }
+}
+
+static uint32_t directory_extent_length(const IsoNode& dir)
+{
+    size_t pos = 2 * record_length(1);
+
+    for(const auto& child : dir.children)
+    {
+        size_t rec_length = record_length(child.name16.size() * 2);
+        if(pos % sector_size + rec_length > sector_size)
+            pos += sector_size - pos % sector_size;
+
+        pos += rec_length;
+    }
+
+    return (uint32_t)((pos + sector_size - 1) / sector_size * sector_size);
+}
+
+static void build_directory_extent(std::vector<uint8_t>& extent, const IsoNode& dir, const IsoNode& parent)
+{
+    extent.clear();
+
+    const uint8_t dot = 0;
+    const uint8_t dotdot = 1;
+    append_record(extent, &dot, 1, dir.sector, dir.length, true);
+    append_record(extent, &dotdot, 1, parent.sector, parent.length, true);
+
+    std::vector<uint8_t> name;
+    for(const auto& child : dir.children)
+    {
+        name_to_ucs2be(name, child.name16);
+        append_record(extent, name.data(), name.size(), child.sector, child.length, child.is_dir);
+    }
+
+    extent.resize(dir.length, 0);
+}
+
+// fill a text field with spaces, in UCS-2 if joliet
+static void fill_spaces(uint8_t* dest, size_t length, bool joliet)
+{
+    for(size_t i = 0; i < length; i++)
+        dest[i] = (joliet && i % 2 == 0) ? 0 : ' ';
+}
+
+static void build_volume_descriptor(uint8_t* vd, bool joliet, uint32_t volume_sectors, uint32_t path_table_size, uint32_t l_table, uint32_t m_table, const IsoNode& root)
+{
+    memset(vd, 0, sector_size);
+
+    vd[0] = joliet ? 2 : 1;
+    memcpy(vd + 1, "CD001", 5);
+    vd[6] = 1;
+
+    fill_spaces(vd + 8, 32, joliet);
+    fill_spaces(vd + 40, 32, joliet);
+
+    // volume identifier
+    const char* volume_id = "CDROM";
+    for(size_t i = 0; volume_id[i]; i++)
+    {
+        if(joliet)
+            vd[40 + 2 * i + 1] = (uint8_t)volume_id[i];
+        else
+            vd[40 + i] = (uint8_t)volume_id[i];
+    }
+
+    write_both32(vd + 80, volume_sectors);
+
+    if(joliet)
+    {
+        // UCS-2 level 3
+        vd[88] = 0x25;
+        vd[89] = 0x2F;
+        vd[90] = 0x45;
+    }
+
+    write_both16(vd + 120, 1);
+    write_both16(vd + 124, 1);
+    write_both16(vd + 128, (uint16_t)sector_size);
+    write_both32(vd + 132, path_table_size);
+
+    for(int i = 0; i < 4; i++)
+    {
+        vd[140 + i] = (uint8_t)(l_table >> (8 * i));
+        vd[148 + 3 - i] = (uint8_t)(m_table >> (8 * i));
+    }
+
+    // root directory record
+    vd[156] = 34;
+    write_both32(vd + 156 + 2, root.sector);
+    write_both32(vd + 156 + 10, root.length);
+    vd[156 + 25] = 2;
+    write_both16(vd + 156 + 28, 1);
+    vd[156 + 32] = 1;
+
+    // volume set, publisher, preparer, application, and file identifiers
+    fill_spaces(vd + 190, 128 * 4 + 37 * 3, joliet);
+
+    // unset dates, so that builds are reproducible
+    for(int d = 0; d < 4; d++)
+        memset(vd + 813 + 17 * d, '0', 16);
+
+    vd[881] = 1;
+}
+
+// build a path table; little-endian or big-endian
+static void build_path_table(std::vector<uint8_t>& table, const std::vector<const IsoNode*>& dirs, bool big_endian)
+{
+    table.clear();
+
+    std::vector<uint8_t> name;
+    for(const IsoNode* dir : dirs)
+    {
+        if(dir->dir_number == 1)
+            name.assign(1, 0);
+        else
+            name_to_ucs2be(name, dir->name16);
+
+        size_t pos = table.size();
+        table.resize(pos + 8 + name.size() + (name.size() % 2), 0);
+
+        uint8_t* rec = &table[pos];
+        rec[0] = (uint8_t)name.size();
+
+        for(int i = 0; i < 4; i++)
+        {
+            if(big_endian)
+                rec[2 + 3 - i] = (uint8_t)(dir->sector >> (8 * i));
+            else
+                rec[2 + i] = (uint8_t)(dir->sector >> (8 * i));
+        }
+
+        rec[big_endian ? 7 : 6] = (uint8_t)(dir->parent_number);
+        rec[big_endian ? 6 : 7] = (uint8_t)(dir->parent_number >> 8);
+
+        memcpy(rec + 8, name.data(), name.size());
+    }
+}
+
+// write data (if any), then pad the output to the end of the sector
+static bool write_padded(FILE* outf, const uint8_t* data, size_t length)
+{
+    static const uint8_t zeros[sector_size] = {};
+
+    if(data && length && fwrite(data, 1, length, outf) != length)
+        return false;
+
+    size_t pad = (sector_size - length % sector_size) % sector_size;
+    return !pad || fwrite(zeros, 1, pad, outf) == pad;
+}
+
+static bool copy_file(FILE* outf, const IsoNode& file)
+{
+    FILE* inf = fopen(file.path.u8string().c_str(), "rb");
+    if(!inf)
+        return false;
+
+    std::vector<uint8_t> buffer(256 * 1024);
+    uint32_t left = file.length;
+
+    while(left > 0)
+    {
+        size_t to_read = std::min<size_t>(left, buffer.size());
+        if(fread(buffer.data(), 1, to_read, inf) != to_read || fwrite(buffer.data(), 1, to_read, outf) != to_read)
+        {
+            fclose(inf);
+            return false;
+        }
+
+        left -= (uint32_t)to_read;
+    }
+
+    fclose(inf);
+
+    return write_padded(outf, nullptr, file.length);
+}
+
+bool LZ4Pack::build_iso(FILE* outf, const char* root_dir, const std::vector<std::string>& file_order)
+{
+    if(!outf || !root_dir)
+        return false;
+
+    IsoNode root;
+    root.path = fs::u8path(root_dir);
+    root.is_dir = true;
+
+    if(!scan_directory(root))
+        return false;
+
+    // number the directories in path table order (breadth-first), and list the files in directory order
+    std::vector<IsoNode*> dirs;
+    std::vector<IsoNode*> files;
+    std::unordered_map<std::string, IsoNode*> files_by_path;
+
+    root.dir_number = 1;
+    root.parent_number = 1;
+    dirs.push_back(&root);
+
+    for(size_t d = 0; d < dirs.size(); d++)
+    {
+        for(auto& child : dirs[d]->children)
+        {
+            if(child.is_dir)
+            {
+                if(dirs.size() >= 0xFFFF)
+                    return false;
+
+                child.dir_number = (uint16_t)(dirs.size() + 1);
+                child.parent_number = dirs[d]->dir_number;
+                dirs.push_back(&child);
+            }
+            else
+            {
+                files.push_back(&child);
+                files_by_path[child.iso_path] = &child;
+            }
+        }
+    }
+
+    // place the listed files first, in the listed order, and then the rest in directory order
+    std::vector<IsoNode*> placement;
+    placement.reserve(files.size());
+
+    for(const auto& path : file_order)
+    {
+        auto it = files_by_path.find(path);
+        if(it == files_by_path.end() || it->second->placed)
+            continue;
+
+        it->second->placed = true;
+        placement.push_back(it->second);
+    }
+
+    for(IsoNode* file : files)
+    {
+        if(!file->placed)
+            placement.push_back(file);
+    }
+
+    // layout: system area, volume descriptors (primary, Joliet, terminator), path tables, directories, files
+    std::vector<const IsoNode*> const_dirs(dirs.begin(), dirs.end());
+    std::vector<uint8_t> table;
+    build_path_table(table, const_dirs, false);
+
+    uint32_t joliet_table_size = (uint32_t)table.size();
+    uint32_t joliet_table_sectors = (joliet_table_size + sector_size - 1) / sector_size;
+
+    // the primary volume's root is empty, so its path tables have a single record
+    constexpr uint32_t primary_table_size = 10;
+
+    uint32_t sector = 19;
+    uint32_t primary_l_table = sector++;
+    uint32_t primary_m_table = sector++;
+    uint32_t joliet_l_table = sector;
+    sector += joliet_table_sectors;
+    uint32_t joliet_m_table = sector;
+    sector += joliet_table_sectors;
+
+    IsoNode primary_root;
+    primary_root.is_dir = true;
+    primary_root.sector = sector++;
+    primary_root.length = sector_size;
+
+    // all directory records are contiguous, so that a full scan of the filesystem reads a single range
+    for(IsoNode* dir : dirs)
+    {
+        dir->sector = sector;
+        dir->length = directory_extent_length(*dir);
+        sector += dir->length / sector_size;
+    }
+
+    for(IsoNode* file : placement)
+    {
+        uint32_t file_sectors = (file->length + sector_size - 1) / sector_size;
+        if(file_sectors > UINT32_MAX / sector_size - sector)
+        {
+            fprintf(stderr, "Directory too large for ISO image\n");
+            return false;
+        }
+
+        file->sector = sector;
+        sector += file_sectors;
+    }
+
+    uint32_t volume_sectors = sector;
+
+    // now write everything in order
+    std::vector<uint8_t> buffer(sector_size * 16, 0);
+    if(!write_padded(outf, buffer.data(), buffer.size()))
+        return false;
+
+    buffer.resize(sector_size * 3);
+    std::fill(buffer.begin(), buffer.end(), 0);
+    build_volume_descriptor(&buffer[0], false, volume_sectors, primary_table_size, primary_l_table, primary_m_table, primary_root);
+    build_volume_descriptor(&buffer[sector_size], true, volume_sectors, joliet_table_size, joliet_l_table, joliet_m_table, root);
+
+    uint8_t* terminator = &buffer[sector_size * 2];
+    terminator[0] = 255;
+    memcpy(terminator + 1, "CD001", 5);
+    terminator[6] = 1;
+
+    if(!write_padded(outf, buffer.data(), buffer.size()))
+        return false;
+
+    const std::vector<const IsoNode*> primary_dirs = {&primary_root};
+    primary_root.dir_number = 1;
+    primary_root.parent_number = 1;
+
+    build_path_table(table, primary_dirs, false);
+    if(!write_padded(outf, table.data(), table.size()))
+        return false;
+
+    build_path_table(table, primary_dirs, true);
+    if(!write_padded(outf, table.data(), table.size()))
+        return false;
+
+    build_path_table(table, const_dirs, false);
+    if(!write_padded(outf, table.data(), table.size()))
+        return false;
+
+    build_path_table(table, const_dirs, true);
+    if(!write_padded(outf, table.data(), table.size()))
+        return false;
+
+    std::vector<uint8_t> extent;
+    build_directory_extent(extent, primary_root, primary_root);
+    if(!write_padded(outf, extent.data(), extent.size()))
+        return false;
+
+    for(const IsoNode* dir : dirs)
+    {
+        const IsoNode* parent = (dir->parent_number == dir->dir_number) ? dir : dirs[dir->parent_number - 1];
+
+        build_directory_extent(extent, *dir, *parent);
+        if(!write_padded(outf, extent.data(), extent.size()))
+            return false;
+    }
+
+    for(const IsoNode* file : placement)
+    {
+        if(!copy_file(outf, *file))
+        {
+            fprintf(stderr, "Failed to copy %s\n", file->path.u8string().c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LZ4Pack::load_path_list(std::vector<std::string>& out, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if(!f)
+        return false;
+
+    out.clear();
+
+    std::string line;
+    int c;
+    while((c = fgetc(f)) != EOF)
+    {
+        if(c == '\n')
+        {
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if(!line.empty())
+                out.push_back(line);
+
+            line.clear();
+        }
+        else
+            line.push_back((char)c);
+    }
+
+    if(!line.empty())
+        out.push_back(line);
+
+    fclose(f);
+
+    return true;
+}
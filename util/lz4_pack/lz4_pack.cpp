@@ -19,7 +19,13 @@
 
 #include <cstdio>
 #include <string>
+#include <cstring>
 #include <limits>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include "lz4.h"
 #include "lz4hc.h"
 #define XXH_NAMESPACE LZ4_
@@ -51,22 +57,301 @@ static inline void write_uint32(uint8_t* dest, uint32_t value, bool big_endian)
         write_uint32_le(dest, value);
 }
 
-bool LZ4Pack::compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian)
+// number of blocks in flight for each compression thread
+static constexpr size_t blocks_per_thread = 16;
+
+// blocks whose fast compression would still be stored if HC saved this many more percentage points of the block are stored without trying HC (adaptive mode and the pre-check)
+static constexpr size_t hopeless_margin = 20;
+
+// adaptive mode: escalate to the next level only if the previous one saved at least 1/this of the block
+static constexpr size_t adaptive_min_gain = 64;
+
+// a block on its way through compress: read, then compressed by a pool thread, then written
+struct BlockSlot
+{
+    char* in = nullptr;
+    char* out = nullptr;
+    size_t length = 0;
+    int packed_size = 0;
+
+    // if nonzero, the header word of the previous archive's copy of this block, whose payload is in out
+    uint32_t reused_header = 0;
+
+    // set by the pool thread once packed_size is ready, under the queue mutex
+    bool done = false;
+};
+
+// whether a block of length bytes which compresses to packed bytes should be stored, after crediting compression with margin percentage points of the block
+static bool should_store(size_t packed, size_t length, const LZ4Pack::Options& options, size_t margin = 0)
+{
+    if(!options.read_mbps)
+        return packed * 100 > length * (options.stored_threshold + margin);
+
+    // a stored block costs length / read to read; a compressed one costs packed / read to read plus length / decode to decode
+    size_t saved = length * margin / 100;
+    if(packed < length)
+        saved += length - packed;
+
+    return (uint64_t)saved * options.decode_mbps <= (uint64_t)length * options.read_mbps;
+}
+
+// per-thread compression state
+struct BlockPacker
+{
+    void* fast_state = nullptr;
+    void* hc_state = nullptr;
+    char* scratch = nullptr;
+
+    bool init(size_t out_block_max)
+    {
+        fast_state = malloc(LZ4_sizeofState());
+        hc_state = malloc(LZ4_sizeofStateHC());
+        scratch = (char*)malloc(out_block_max);
+
+        return fast_state && hc_state && scratch;
+    }
+
+    ~BlockPacker()
+    {
+        free(fast_state);
+        free(hc_state);
+        free(scratch);
+    }
+
+    // compress a block into out, returning its compressed size (or 0 on failure)
+    int pack(const char* in, int in_size, char* out, int out_max, const LZ4Pack::Options& options)
+    {
+        if(!options.adaptive && !options.precheck)
+            return LZ4_compress_HC_extStateHC(hc_state, in, out, in_size, out_max, LZ4HC_CLEVEL_MAX);
+
+        // start with the fast compressor, which costs a small fraction of HC max and quickly gives up on incompressible data
+        int best = LZ4_compress_fast_extState(fast_state, in, out, in_size, out_max, 1);
+        if(best <= 0)
+            return 0;
+
+        // far from worth decoding (already-compressed media, for example), so HC will not rescue it either
+        if(should_store((size_t)best, (size_t)in_size, options, hopeless_margin))
+            return best;
+
+        if(!options.adaptive)
+            return LZ4_compress_HC_extStateHC(hc_state, in, out, in_size, out_max, LZ4HC_CLEVEL_MAX);
+
+        // adaptive: only spend HC time on blocks where it saves space
+
+        size_t prev_gain = (size_t)in_size;
+        for(int level : {LZ4HC_CLEVEL_DEFAULT, LZ4HC_CLEVEL_MAX})
+        {
+            if(prev_gain * adaptive_min_gain < (size_t)in_size)
+                break;
+
+            int got = LZ4_compress_HC_extStateHC(hc_state, in, scratch, in_size, out_max, level);
+            if(got <= 0 || got >= best)
+                break;
+
+            prev_gain = (size_t)(best - got);
+            best = got;
+            memcpy(out, scratch, got);
+        }
+
+        return best;
+    }
+};
+
+static uint32_t read_uint32(const uint8_t* src, bool big_endian)
+{
+    if(big_endian)
+        return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | (uint32_t)src[3];
+    else
+        return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+// the blocks of a previous archive, for reuse by an incremental repack
+struct PreviousArchive
+{
+    FILE* file = nullptr;
+    uint32_t file_size = 0;
+    uint32_t block_size = 0;
+    std::vector<uint32_t> block_offsets;
+
+    // content hash to block index
+    std::unordered_map<uint32_t, uint32_t> blocks_by_hash;
+
+    std::vector<char> content;
+
+    uint32_t block_length(uint32_t block) const
+    {
+        return (block + 1 < block_offsets.size()) ? block_size : file_size - block * block_size;
+    }
+
+    // reads a block's header word and payload (at most out_max bytes); returns the header word, or 0 on failure
+    uint32_t read_block(uint32_t block, char* payload, size_t out_max)
+    {
+        uint8_t header_bytes[4];
+        if(fseek(file, block_offsets[block], SEEK_SET) != 0 || fread(header_bytes, 1, 4, file) != 4)
+            return 0;
+
+        uint32_t header = read_uint32(header_bytes, false);
+        uint32_t length = header & ~(uint32_t)0x80000000;
+
+        if(length == 0 || length > out_max || fread(payload, 1, length, file) != length)
+            return 0;
+
+        return header;
+    }
+
+    // unpacks a block's payload into content, returning whether it holds the expected length
+    bool unpack(uint32_t block, uint32_t header, const char* payload)
+    {
+        uint32_t length = block_length(block);
+        uint32_t payload_length = header & ~(uint32_t)0x80000000;
+
+        if(header & 0x80000000)
+        {
+            if(payload_length != length)
+                return false;
+
+            memcpy(content.data(), payload, length);
+            return true;
+        }
+
+        return LZ4_decompress_safe(payload, content.data(), (int)payload_length, (int)block_size) == (int)length;
+    }
+
+    // reads the mbediso frame at frame_pos, which ends with a trailer of trailer_length bytes in streamed archives
+    bool load_index(long frame_pos, uint32_t trailer_length)
+    {
+        uint8_t header[20];
+        if(fseek(file, frame_pos, SEEK_SET) != 0 || fread(header, 1, sizeof(header), file) != sizeof(header))
+            return false;
+
+        if(memcmp(header, "\x50\x2a\x4d\x18", 4) != 0 || header[8] != 'M' || header[9] != 'I' || header[11] != 'E' || (header[10] != 'L' && header[10] != 'B'))
+            return false;
+
+        bool big_endian = (header[10] == 'B');
+        file_size = read_uint32(header + 12, big_endian);
+        block_size = read_uint32(header + 16, big_endian);
+
+        if(block_size == 0 || block_size > 64*1024)
+            return false;
+
+        uint32_t block_count = (uint32_t)(((uint64_t)file_size + (block_size - 1)) / block_size);
+        if(read_uint32(header + 4, false) != 12 + block_count * 4 + trailer_length)
+            return false;
+
+        std::vector<uint8_t> offsets(block_count * 4);
+        if(block_count && fread(offsets.data(), 1, offsets.size(), file) != offsets.size())
+            return false;
+
+        block_offsets.resize(block_count);
+        for(uint32_t i = 0; i < block_count; i++)
+            block_offsets[i] = read_uint32(&offsets[i * 4], big_endian);
+
+        return true;
+    }
+
+    // reads the block index of an archive written by compress, and hashes the content of each block
+    bool load(FILE* f)
+    {
+        file = f;
+
+        // the index follows the empty frame at the start, or (when streamed) precedes the trailer at the end
+        if(!load_index(11, 0))
+        {
+            uint8_t trailer[8];
+            if(fseek(file, -8, SEEK_END) != 0 || fread(trailer, 1, 8, file) != 8 || memcmp(trailer, "MITR", 4) != 0)
+                return false;
+
+            long frame_length = (long)read_uint32(trailer + 4, false);
+            if(fseek(file, 0, SEEK_END) != 0)
+                return false;
+
+            long frame_pos = ftell(file) - frame_length;
+            if(frame_pos < 0 || !load_index(frame_pos, 8))
+                return false;
+        }
+
+        uint32_t block_count = (uint32_t)block_offsets.size();
+
+        content.resize(block_size);
+        std::vector<char> payload(block_size);
+
+        for(uint32_t i = 0; i < block_count; i++)
+        {
+            uint32_t header_word = read_block(i, payload.data(), payload.size());
+            if(!header_word || !unpack(i, header_word, payload.data()))
+                return false;
+
+            blocks_by_hash.emplace(XXH32(content.data(), block_length(i), 0), i);
+        }
+
+        return true;
+    }
+
+    // looks for a block with the same content as data, copying its header word and payload if found; returns the header word, or 0 if none matches
+    uint32_t find(const char* data, size_t length, char* payload, size_t out_max)
+    {
+        auto it = blocks_by_hash.find(XXH32(data, length, 0));
+        if(it == blocks_by_hash.end() || block_length(it->second) != length)
+            return 0;
+
+        // hashes may collide, so compare the actual content
+        uint32_t header = read_block(it->second, payload, out_max);
+        if(!header || !unpack(it->second, header, payload) || memcmp(content.data(), data, length) != 0)
+            return 0;
+
+        return header;
+    }
+};
+
+bool LZ4Pack::compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian, unsigned threads)
+{
+    Options options;
+    options.block_size = block_size;
+    options.big_endian = big_endian;
+    options.threads = threads;
+
+    return compress(outf, inf, options);
+}
+
+bool LZ4Pack::compress(FILE* outf, FILE* inf, const Options& options)
 {
     if(!outf || !inf)
         return false;
 
-    if(block_size > 64*1024)
+    size_t block_size = options.block_size;
+    bool big_endian = options.big_endian;
+    unsigned threads = options.threads;
+
+    if(block_size == 0 || block_size > 64*1024 || options.stored_threshold > 100 || (options.read_mbps && !options.decode_mbps))
         return false;
 
     size_t out_block_max = LZ4_compressBound(block_size);
 
-    fseek(inf, 0, SEEK_END);
-    size_t inf_size = ftell(inf);
-    fseek(inf, 0, SEEK_SET);
+    // incremental repack: reuse the packed blocks of the previous archive where the content is unchanged
+    PreviousArchive previous;
+    bool have_previous = false;
 
-    if(inf_size > std::numeric_limits<uint32_t>::max())
-        return false;
+    if(options.previous)
+    {
+        if(!previous.load(options.previous))
+            return false;
+
+        // blocks can only be reused at the same block size
+        have_previous = (previous.block_size == block_size);
+    }
+
+    // a streamed input is read until its end, so its size is only known afterwards
+    size_t inf_size = 0;
+
+    if(!options.streaming)
+    {
+        fseek(inf, 0, SEEK_END);
+        inf_size = ftell(inf);
+        fseek(inf, 0, SEEK_SET);
+
+        if(inf_size > std::numeric_limits<uint32_t>::max())
+            return false;
+    }
 
     // an lz4 frame endmark
     uint32_t endmark = 0;
@@ -95,108 +380,276 @@ bool LZ4Pack::compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian
 
     size_t block_count = (inf_size + (block_size - 1)) / block_size;
     uint8_t mbediso_frame_header[20];
-    uint32_t mbediso_frame_length = sizeof(mbediso_frame_header) + block_count * 4;
-    uint32_t mbediso_frame_inner_length = mbediso_frame_length - 8;
 
     // lz4 magic number for skippable frame
     mbediso_frame_header[0] = 0x50;
     mbediso_frame_header[1] = 0x2a;
     mbediso_frame_header[2] = 0x4d;
     mbediso_frame_header[3] = 0x18;
-    // lz4 little-endian frame size
-    write_uint32_le(&mbediso_frame_header[4], mbediso_frame_inner_length);
     // mbediso magic number
     mbediso_frame_header[8] = 'M';
     mbediso_frame_header[9] = 'I';
     mbediso_frame_header[10] = (big_endian) ? 'B' : 'L';
     mbediso_frame_header[11] = 'E';
-    // mbediso file size
-    write_uint32(&mbediso_frame_header[12], inf_size, big_endian);
     // mbediso block size
     write_uint32(&mbediso_frame_header[16], block_size, big_endian);
 
-    uint8_t* mbediso_block_offsets = (uint8_t*)malloc(block_count * 4);
-    if(!mbediso_block_offsets)
-        return false;
+    // block offsets, in the archive's byte order
+    std::vector<uint8_t> mbediso_block_offsets;
+    mbediso_block_offsets.reserve(block_count * 4);
 
     // initialize hash state
     auto hash_state = XXH32_createState();
     if(!hash_state)
-    {
-        free(mbediso_block_offsets);
         return false;
-    }
     XXH32_reset(hash_state, 0);
 
     // WRITE ALL HEADERS TO FILE!!
-    fseek(outf, 0, SEEK_SET);
+    // the output position is tracked here rather than queried, so that a streamed output need not be seekable
+    uint64_t out_pos = 0;
 
-    fwrite(fake_header, 1, 7, outf);
-    fwrite(&endmark, 4, 1, outf);
+    if(!options.streaming)
+    {
+        // lz4 little-endian frame size
+        write_uint32_le(&mbediso_frame_header[4], sizeof(mbediso_frame_header) - 8 + block_count * 4);
+        // mbediso file size
+        write_uint32(&mbediso_frame_header[12], inf_size, big_endian);
 
-    fwrite(mbediso_frame_header, 1, sizeof(mbediso_frame_header), outf);
-    auto block_offset_table_cursor = ftell(outf);
-    fseek(outf, block_count * 4, SEEK_CUR);
+        fseek(outf, 0, SEEK_SET);
+
+        fwrite(fake_header, 1, 7, outf);
+        fwrite(&endmark, 4, 1, outf);
+
+        fwrite(mbediso_frame_header, 1, sizeof(mbediso_frame_header), outf);
+        fseek(outf, block_count * 4, SEEK_CUR);
+
+        out_pos = 7 + 4 + sizeof(mbediso_frame_header) + block_count * 4;
+    }
 
     fwrite(real_header, 1, 7, outf);
+    out_pos += 7;
 
     // WRITE ALL BLOCKS TO FILE!
+    // a pool of threads compresses the blocks while this thread reads the input and writes the finished blocks in order; blocks pass through a ring of slots, bounding memory use to the slot buffers
+    if(threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if(threads == 0)
+        threads = 1;
+
+    size_t slot_count = threads * blocks_per_thread;
+    if(slot_count > block_count && !options.streaming)
+        slot_count = block_count;
+    if(slot_count == 0)
+        slot_count = 1;
+
     bool success = false;
-    char* in_block = (char*)malloc(block_size);
-    char* out_block = (char*)malloc(out_block_max);
-    if(in_block && out_block)
+    char* in_slots = (char*)malloc(slot_count * block_size);
+    char* out_slots = (char*)malloc(slot_count * out_block_max);
+    std::vector<BlockSlot> slots(slot_count);
+    std::vector<BlockPacker> packers(threads);
+
+    bool have_states = true;
+    for(auto& packer : packers)
     {
-        size_t block_index = 0;
+        if(!packer.init(out_block_max))
+            have_states = false;
+    }
+
+    if(in_slots && out_slots && have_states)
+    {
+        // blocks [0, claimed) have been taken by a compression thread, and blocks [0, queued) have been read
+        std::mutex queue_mutex;
+        std::condition_variable work_ready;
+        std::condition_variable block_done;
+        size_t queued = 0;
+        size_t claimed = 0;
+        bool stop = false;
+
+        auto worker = [&](BlockPacker* packer) {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+
+            while(true)
+            {
+                work_ready.wait(lock, [&] { return stop || claimed < queued; });
+                if(stop)
+                    return;
+
+                BlockSlot& slot = slots[claimed++ % slot_count];
+                lock.unlock();
+
+                if(!slot.reused_header)
+                    slot.packed_size = packer->pack(slot.in, (int)slot.length, slot.out, (int)out_block_max, options);
+
+                lock.lock();
+                slot.done = true;
+                block_done.notify_one();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for(unsigned t = 0; t < threads; t++)
+            pool.emplace_back(worker, &packers[t]);
+
         size_t bytes_left = inf_size;
+        size_t read_count = 0;
+        size_t write_count = 0;
+        bool at_end = false;
+        bool failed = false;
+
+        // a streamed input is read until its end, and any other input until its known size
+        auto input_done = [&] { return options.streaming ? at_end : bytes_left == 0; };
 
-        while(bytes_left > 0)
+        while(!failed)
         {
-            size_t to_compress = bytes_left;
-            if(to_compress > block_size)
-                to_compress = block_size;
+            // write out the finished blocks, in order
+            while(write_count < read_count)
+            {
+                BlockSlot& slot = slots[write_count % slot_count];
 
-            if(fread(in_block, 1, to_compress, inf) != to_compress)
-                break;
+                // wait for the oldest block only if there is no room to read another
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    if(!slot.done && read_count - write_count < slot_count && !input_done())
+                        break;
+
+                    block_done.wait(lock, [&] { return slot.done; });
+                }
+
+                // block offsets are 32-bit
+                if(out_pos + 4 + out_block_max > std::numeric_limits<uint32_t>::max())
+                {
+                    failed = true;
+                    break;
+                }
+
+                uint8_t block_dest[4];
+                write_uint32(block_dest, (uint32_t)out_pos, big_endian);
+                mbediso_block_offsets.insert(mbediso_block_offsets.end(), block_dest, block_dest + 4);
+
+                uint8_t block_header[4];
+                uint32_t header;
+                const char* payload;
+
+                if(slot.reused_header)
+                {
+                    // copy a reused block as it was
+                    header = slot.reused_header;
+                    payload = slot.out;
+                }
+                else if(slot.packed_size <= 0)
+                {
+                    failed = true;
+                    break;
+                }
+                else if(should_store((size_t)slot.packed_size, slot.length, options))
+                {
+                    // fall back to uncompressed data if it saves too little: stored blocks are read without decoding
+                    header = (uint32_t)slot.length | 0x80000000;
+                    payload = slot.in;
+                }
+                else
+                {
+                    header = (uint32_t)slot.packed_size;
+                    payload = slot.out;
+                }
+
+                size_t to_write = header & ~(uint32_t)0x80000000;
+                write_uint32_le(block_header, header);
+
+                if(fwrite(block_header, 1, 4, outf) != 4 || fwrite(payload, 1, to_write, outf) != to_write)
+                {
+                    failed = true;
+                    break;
+                }
 
-            XXH32_update(hash_state, in_block, to_compress);
+                out_pos += 4 + to_write;
+                slot.done = false;
+                write_count++;
+            }
 
-            auto _to_write = LZ4_compress_HC(in_block, out_block, to_compress, out_block_max, LZ4HC_CLEVEL_MAX);
-            if(_to_write <= 0)
+            if(failed || (write_count == read_count && input_done()))
                 break;
 
-            size_t to_write = (size_t)_to_write;
+            if(input_done())
+                continue;
 
-            uint32_t block_dest = (uint32_t)ftell(outf);
-            write_uint32(&mbediso_block_offsets[block_index * 4], block_dest, big_endian);
+            // read the next block into a free slot
+            BlockSlot& slot = slots[read_count % slot_count];
+            slot.in = in_slots + (read_count % slot_count) * block_size;
+            slot.out = out_slots + (read_count % slot_count) * out_block_max;
 
-            uint8_t block_header[4];
+            size_t to_read = block_size;
+            if(!options.streaming && to_read > bytes_left)
+                to_read = bytes_left;
 
-            // fall back to uncompressed data if worse than 50% compression ratio
-            if(to_write > to_compress * 5 / 10)
-            {
-                write_uint32_le(block_header, to_compress | 0x80000000);
+            size_t got = fread(slot.in, 1, to_read, inf);
 
-                if(fwrite(block_header, 1, 4, outf) != 4 || fwrite(in_block, 1, to_compress, outf) != to_compress)
+            if(options.streaming)
+            {
+                if(got < to_read)
+                {
+                    if(ferror(inf))
+                    {
+                        failed = true;
+                        break;
+                    }
+
+                    at_end = true;
+                }
+
+                if(inf_size + got > std::numeric_limits<uint32_t>::max())
+                {
+                    failed = true;
                     break;
+                }
+
+                inf_size += got;
+                bytes_left += got;
+
+                if(got == 0)
+                    continue;
             }
-            else
+            else if(got != to_read)
             {
-                write_uint32_le(block_header, to_write);
+                failed = true;
+                break;
+            }
 
-                if(fwrite(block_header, 1, 4, outf) != 4 || fwrite(out_block, 1, to_write, outf) != to_write)
-                    break;
+            bytes_left -= got;
+            slot.length = got;
+
+            XXH32_update(hash_state, slot.in, got);
+
+            // the previous archive may already hold this block
+            slot.reused_header = 0;
+            if(have_previous)
+                slot.reused_header = previous.find(slot.in, got, slot.out, out_block_max);
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queued++;
             }
 
-            block_index++;
-            bytes_left -= to_compress;
+            work_ready.notify_one();
+            read_count++;
         }
 
-        if(bytes_left == 0)
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+
+        work_ready.notify_all();
+
+        for(auto& thread : pool)
+            thread.join();
+
+        if(!failed)
             success = true;
     }
 
-    free(in_block);
-    free(out_block);
+    free(in_slots);
+    free(out_slots);
 
 
     // FINALIZE REAL FRAME
@@ -210,13 +663,138 @@ bool LZ4Pack::compress(FILE* outf, FILE* inf, size_t block_size, bool big_endian
     fwrite(checksum_bytes, 1, 4, outf);
 
     // WRITE BLOCK OFFSET TABLE
-    fseek(outf, block_offset_table_cursor, SEEK_SET);
-    fwrite(mbediso_block_offsets, 1, block_count * 4, outf);
+    if(options.streaming)
+    {
+        // as a final skippable frame, ending with a trailer that gives the frame's length: "MITR" and the little-endian length
+        uint32_t mbediso_frame_length = sizeof(mbediso_frame_header) + mbediso_block_offsets.size() + 8;
+        write_uint32_le(&mbediso_frame_header[4], mbediso_frame_length - 8);
+        write_uint32(&mbediso_frame_header[12], inf_size, big_endian);
+
+        uint8_t trailer[8] = {'M', 'I', 'T', 'R'};
+        write_uint32_le(&trailer[4], mbediso_frame_length);
+
+        if(fwrite(mbediso_frame_header, 1, sizeof(mbediso_frame_header), outf) != sizeof(mbediso_frame_header)
+            || (!mbediso_block_offsets.empty() && fwrite(mbediso_block_offsets.data(), 1, mbediso_block_offsets.size(), outf) != mbediso_block_offsets.size())
+            || fwrite(trailer, 1, sizeof(trailer), outf) != sizeof(trailer))
+        {
+            success = false;
+        }
+    }
+    else if(!mbediso_block_offsets.empty())
+    {
+        // in the space left after the header
+        fseek(outf, 7 + 4 + sizeof(mbediso_frame_header), SEEK_SET);
+        fwrite(mbediso_block_offsets.data(), 1, mbediso_block_offsets.size(), outf);
+    }
 
     // finalize state
-    free(mbediso_block_offsets);
     XXH32_freeState(hash_state);
 
 
     return success;
 }
+
+bool LZ4Pack::append_index(FILE* archive)
+{
+    if(!archive)
+        return false;
+
+    // magic number, FLG, and BD
+    uint8_t descriptor[8];
+    if(fseek(archive, 0, SEEK_SET) != 0 || fread(descriptor, 1, 6, archive) != 6 || memcmp(descriptor, "\x04\x22\x4d\x18", 4) != 0)
+        return false;
+
+    uint8_t flg = descriptor[4];
+    uint8_t bd = descriptor[5];
+
+    // version 1, independent blocks, no dictionary
+    if((flg >> 6) != 1 || !(flg & 0x20) || (flg & 0x01) || (flg & 0x02) || ((bd >> 4) & 7) < 4)
+        return false;
+
+    bool block_checksums = (flg & 0x10);
+    bool content_checksum = (flg & 0x04);
+    bool has_content_size = (flg & 0x08);
+    uint32_t block_size = (uint32_t)(64*1024) << (2 * (((bd >> 4) & 7) - 4));
+
+    uint64_t file_size = 0;
+    if(has_content_size)
+    {
+        if(fread(descriptor, 1, 8, archive) != 8)
+            return false;
+
+        for(int i = 7; i >= 0; i--)
+            file_size = (file_size << 8) | descriptor[i];
+    }
+
+    // walk the blocks, which must each hold block_size bytes except the last (as written by the lz4 tool); compressed blocks are decoded, since only their output shows whether they are full
+    std::vector<uint32_t> block_offsets;
+    std::vector<char> payload(block_size);
+    std::vector<char> content(block_size);
+    uint32_t last_size = 0;
+    uint64_t pos = (has_content_size) ? 15 : 7;
+
+    while(true)
+    {
+        uint8_t header_bytes[4];
+        if(pos > std::numeric_limits<uint32_t>::max() || fseek(archive, (long)pos, SEEK_SET) != 0 || fread(header_bytes, 1, 4, archive) != 4)
+            return false;
+
+        uint32_t header = read_uint32(header_bytes, false);
+        if(header == 0)
+            break;
+
+        uint32_t length = header & ~(uint32_t)0x80000000;
+        if(length == 0 || length > block_size || (!block_offsets.empty() && last_size != block_size))
+            return false;
+
+        if(header & 0x80000000)
+            last_size = length;
+        else
+        {
+            if(fread(payload.data(), 1, length, archive) != length)
+                return false;
+
+            int got = LZ4_decompress_safe(payload.data(), content.data(), (int)length, (int)block_size);
+            if(got <= 0)
+                return false;
+
+            last_size = (uint32_t)got;
+        }
+
+        block_offsets.push_back((uint32_t)pos);
+
+        pos += 4 + (uint64_t)length + (block_checksums ? 4 : 0);
+    }
+
+    // the index goes right after the frame, so there must be nothing else in the file (such as an index appended earlier)
+    long frame_end = (long)pos + 4 + (content_checksum ? 4 : 0);
+    if(block_offsets.empty() || fseek(archive, 0, SEEK_END) != 0 || ftell(archive) != frame_end)
+        return false;
+
+    // the blocks must hold exactly the content size, if given
+    uint64_t blocks_size = (uint64_t)(block_offsets.size() - 1) * block_size + last_size;
+    if(!has_content_size)
+        file_size = blocks_size;
+
+    if(file_size > std::numeric_limits<uint32_t>::max() || file_size != blocks_size)
+        return false;
+
+    // a final skippable frame, as written by a streaming compress
+    uint8_t frame_header[20] = {0x50, 0x2a, 0x4d, 0x18, 0, 0, 0, 0, 'M', 'I', 'L', 'E'};
+    uint32_t frame_length = sizeof(frame_header) + (uint32_t)block_offsets.size() * 4 + 8;
+    write_uint32_le(&frame_header[4], frame_length - 8);
+    write_uint32_le(&frame_header[12], (uint32_t)file_size);
+    write_uint32_le(&frame_header[16], block_size);
+
+    std::vector<uint8_t> offset_bytes(block_offsets.size() * 4);
+    for(size_t i = 0; i < block_offsets.size(); i++)
+        write_uint32_le(&offset_bytes[i * 4], block_offsets[i]);
+
+    uint8_t trailer[8] = {'M', 'I', 'T', 'R'};
+    write_uint32_le(&trailer[4], frame_length);
+
+    return fseek(archive, 0, SEEK_END) == 0
+        && fwrite(frame_header, 1, sizeof(frame_header), archive) == sizeof(frame_header)
+        && fwrite(offset_bytes.data(), 1, offset_bytes.size(), archive) == offset_bytes.size()
+        && fwrite(trailer, 1, sizeof(trailer), archive) == sizeof(trailer);
+}
@@ -18,39 +18,288 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <string>
+#include <vector>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "lz4_pack.h"
 
+// builds the ISO on a separate thread, writing it into a pipe which the compressor reads from
+struct IsoBuildThread
+{
+    const char* build_dir;
+    const std::vector<std::string>* file_order;
+    FILE* pipe_write;
+    bool success = false;
+    std::thread thread;
+
+    void run()
+    {
+        success = LZ4Pack::build_iso(pipe_write, build_dir, *file_order);
+        if(fclose(pipe_write) != 0)
+            success = false;
+    }
+};
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: lz4_pack_cli [options] <input.iso>\n");
+    fprintf(stderr, "       lz4_pack_cli [options] [-p <order.txt>] -d <directory> <output.lz4>\n");
+    fprintf(stderr, "       lz4_pack_cli -x <archive.lz4>\n");
+    fprintf(stderr, "  -b  write a big-endian block offset table\n");
+    fprintf(stderr, "  -B  block size in bytes, at most 65536 (default: 4096; see lz4_pack_tune)\n");
+    fprintf(stderr, "  -t  number of compression threads (default: one per hardware thread)\n");
+    fprintf(stderr, "  -a  adaptive: try faster levels first, using HC only where it shrinks the block\n");
+    fprintf(stderr, "  -e  exhaustive: always try HC max, even on blocks that the fast compressor finds incompressible\n");
+    fprintf(stderr, "  -s  store blocks that compress to more than this percentage of their size (default: 50)\n");
+    fprintf(stderr, "  -m  storage read speed in MB/s: store blocks wherever that is faster to read than decoding them (in place of -s)\n");
+    fprintf(stderr, "  -D  LZ4 decode speed in MB/s for -m (default: 2000)\n");
+    fprintf(stderr, "  -r <previous.lz4>  incremental repack, reusing the unchanged blocks of previous.lz4 (made at the same block size)\n");
+    fprintf(stderr, "  -S  streaming: read and write sequentially, placing the block index at the end (implied by - for stdin or stdout)\n");
+    fprintf(stderr, "  -o  output file (default: <input.iso>.lz4, or stdout for stdin)\n");
+    fprintf(stderr, "  -d  build a Joliet ISO from directory instead of reading one (compressed as it is built when streaming)\n");
+    fprintf(stderr, "  -x  append a block index to an archive made by the lz4 tool (with independent blocks), in place\n");
+    fprintf(stderr, "  -p  place the files listed in order.txt (one path per line, relative to directory) first\n");
+}
+
 int main(int argc, char** argv)
 {
-    if(argc < 2)
+    LZ4Pack::Options options;
+    const char* build_dir = nullptr;
+    const char* order_fn = nullptr;
+    const char* previous_fn = nullptr;
+    const char* out_fn = nullptr;
+
+    // index an existing archive
+    if(argc == 3 && std::string(argv[1]) == "-x")
+    {
+        FILE* archive = fopen(argv[2], "r+b");
+        if(!archive)
+        {
+            fprintf(stderr, "Failed to open %s\n", argv[2]);
+            return -1;
+        }
+
+        // an archive made by compress holds its index after the empty frame at the start, and a streamed (or already indexed) one ends with the "MITR" trailer
+        char leading[4];
+        char trailer[8];
+        bool has_leading = (fseek(archive, 11, SEEK_SET) == 0 && fread(leading, 1, 4, archive) == 4 && memcmp(leading, "\x50\x2a\x4d\x18", 4) == 0);
+        bool has_trailer = (fseek(archive, -8, SEEK_END) == 0 && fread(trailer, 1, 8, archive) == 8 && memcmp(trailer, "MITR", 4) == 0);
+
+        if(has_leading || has_trailer)
+        {
+            fprintf(stderr, "%s is already indexed\n", argv[2]);
+            fclose(archive);
+            return 0;
+        }
+
+        bool success = LZ4Pack::append_index(archive);
+        if(fclose(archive) != 0)
+            success = false;
+
+        if(!success)
+            fprintf(stderr, "Failed to index %s (it must be a single LZ4 frame of independent blocks, all full but the last)\n", argv[2]);
+
+        return (success) ? 0 : 1;
+    }
+
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++)
+    {
+        std::string opt = argv[arg];
+
+        if(opt == "-b")
+            options.big_endian = true;
+        else if(opt == "-a")
+            options.adaptive = true;
+        else if(opt == "-e")
+            options.precheck = false;
+        else if(opt == "-S")
+            options.streaming = true;
+        else if(opt == "-s" && arg + 1 < argc)
+            options.stored_threshold = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-m" && arg + 1 < argc)
+            options.read_mbps = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-D" && arg + 1 < argc)
+            options.decode_mbps = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-d" && arg + 1 < argc)
+            build_dir = argv[++arg];
+        else if(opt == "-p" && arg + 1 < argc)
+            order_fn = argv[++arg];
+        else if(opt == "-o" && arg + 1 < argc)
+            out_fn = argv[++arg];
+        else if(opt == "-B" && arg + 1 < argc)
+            options.block_size = (size_t)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-r" && arg + 1 < argc)
+            previous_fn = argv[++arg];
+        else if(opt == "-t" && arg + 1 < argc)
+            options.threads = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else
+        {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if(arg + 1 != argc || (order_fn && !build_dir) || (out_fn && build_dir))
+    {
+        print_usage();
         return -1;
+    }
 
-    bool want_big_endian = false;
-    if(argv[1][0] == '-' && argv[1][1] == 'b' && argv[1][2] == '\0')
+    FILE* inf = nullptr;
+    std::string outfn;
+    std::vector<std::string> file_order;
+    IsoBuildThread builder;
+
+    if(build_dir)
     {
-        want_big_endian = true;
-        argc--;
-        if(argc < 2)
+        if(order_fn && !LZ4Pack::load_path_list(file_order, order_fn))
+        {
+            fprintf(stderr, "Failed to read %s\n", order_fn);
             return -1;
-        argv[1] = argv[2];
+        }
+
+        outfn = argv[arg];
+        if(outfn == "-")
+            options.streaming = true;
+
+#ifndef _WIN32
+        // compress the ISO while it is being built
+        int fds[2];
+        if(options.streaming && pipe(fds) == 0)
+        {
+            inf = fdopen(fds[0], "rb");
+            builder.pipe_write = fdopen(fds[1], "wb");
+
+            if(!inf || !builder.pipe_write)
+            {
+                fprintf(stderr, "Failed to create pipe\n");
+                return -1;
+            }
+
+            builder.build_dir = build_dir;
+            builder.file_order = &file_order;
+            builder.thread = std::thread(&IsoBuildThread::run, &builder);
+        }
+#endif
+
+        if(!inf)
+        {
+            inf = tmpfile();
+            if(!inf || !LZ4Pack::build_iso(inf, build_dir, file_order))
+            {
+                fprintf(stderr, "Failed to build ISO from %s\n", build_dir);
+                if(inf)
+                    fclose(inf);
+                return -1;
+            }
+        }
     }
+    else
+    {
+        std::string infn = argv[arg];
 
-    if(argc != 2)
+        if(infn == "-")
+        {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            inf = stdin;
+            options.streaming = true;
+            outfn = "-";
+        }
+        else
+        {
+            inf = fopen(infn.c_str(), "rb");
+            outfn = infn + ".lz4";
+        }
+
+        if(out_fn)
+            outfn = out_fn;
+
+        if(outfn == "-")
+            options.streaming = true;
+    }
+
+    if(!inf)
         return -1;
 
-    const char* infn = argv[1];
-    std::string outfn = infn;
-    outfn += ".lz4";
+    // the previous archive may be the output file, so write to a temporary file and replace it afterwards
+    bool to_stdout = (outfn == "-");
+    std::string writefn = outfn;
+
+    if(previous_fn)
+    {
+        options.previous = fopen(previous_fn, "rb");
+        if(!options.previous)
+        {
+            fprintf(stderr, "Failed to open %s\n", previous_fn);
+            fclose(inf);
+            return -1;
+        }
+
+        writefn += ".tmp";
+    }
+
+#ifdef _WIN32
+    if(to_stdout)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
 
-    FILE* inf = fopen(infn, "rb");
-    FILE* outf = fopen(outfn.c_str(), "wb");
+    FILE* outf = (to_stdout) ? stdout : fopen(writefn.c_str(), "wb");
+
+    int ret = !LZ4Pack::compress(outf, inf, options);
+
+    // a failed build ends the ISO early, and only the builder knows
+    if(builder.thread.joinable())
+    {
+        // drain the pipe so that the builder can finish
+        char drain[4096];
+        while(fread(drain, 1, sizeof(drain), inf) > 0)
+        {
+        }
 
-    int ret = !LZ4Pack::compress(outf, inf, 4*1024, want_big_endian);
+        builder.thread.join();
 
-    fclose(inf);
-    fclose(outf);
+        if(!builder.success)
+        {
+            fprintf(stderr, "Failed to build ISO from %s\n", build_dir);
+            ret = 1;
+        }
+    }
+
+    if(inf != stdin)
+        fclose(inf);
+    if(outf && fclose(outf) != 0)
+        ret = 1;
+
+    if(options.previous)
+        fclose(options.previous);
+
+    if(!to_stdout && (options.previous || ret != 0))
+    {
+        if(ret != 0)
+            remove(writefn.c_str());
+        else
+        {
+            // std::filesystem::rename replaces an existing target, unlike rename() on Windows
+            std::error_code ec;
+            std::filesystem::rename(writefn, outfn, ec);
+            if(ec)
+                ret = 1;
+        }
+    }
 
     return ret;
 }
@@ -0,0 +1,289 @@
+/*
+ * mbediso - a minimal library to load data from compressed ISO archives
+ *
+ * Copyright (c) 2024 ds-sloth
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// lz4_pack_tune: packs an ISO at several block sizes, replays a recorded access profile against each archive with several read-ahead limits, and picks the cheapest configuration
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "lz4_pack.h"
+#include "mbediso.h"
+
+// replay trials per configuration (the fastest is kept, to reduce noise)
+static constexpr int replay_trials = 3;
+
+// the profile merges consecutive reads, so long ranges are replayed as reads of this size
+static constexpr size_t replay_read_size = 64*1024;
+
+struct TraceRange
+{
+    uint32_t sector;
+    uint32_t sector_count;
+};
+
+struct ReplayResult
+{
+    bool ok = false;
+    double seconds = 0;
+    mbediso_stats stats = {};
+};
+
+static uint32_t read_uint32_le(const uint8_t* src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+// loads a profile saved by mbediso_save_profile
+static bool load_trace(std::vector<TraceRange>& out, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if(!f)
+        return false;
+
+    uint8_t buffer[8];
+    bool success = (fread(buffer, 1, 8, f) == 8 && memcmp(buffer, "MBPF", 4) == 0);
+
+    uint32_t range_count = success ? read_uint32_le(buffer + 4) : 0;
+
+    for(uint32_t i = 0; success && i < range_count; i++)
+    {
+        success = (fread(buffer, 1, 8, f) == 8);
+        if(success)
+            out.push_back({read_uint32_le(buffer + 0), read_uint32_le(buffer + 4)});
+    }
+
+    fclose(f);
+
+    return success;
+}
+
+static ReplayResult replay(const char* archive, const std::vector<TraceRange>& trace, uint32_t read_ahead)
+{
+    ReplayResult result;
+    std::vector<uint8_t> buffer(replay_read_size);
+
+    for(int trial = 0; trial < replay_trials; trial++)
+    {
+        mbediso_fs* fs = mbediso_openfs_file(archive, false);
+        if(!fs)
+            return result;
+
+        mbediso_set_read_ahead(fs, read_ahead);
+
+        // only count the traced reads
+        mbediso_stats stats;
+        mbediso_get_stats(fs, &stats, true);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for(const auto& range : trace)
+        {
+            uint64_t bytes = (uint64_t)range.sector_count * 2048;
+            if(bytes > UINT32_MAX)
+                bytes = UINT32_MAX;
+
+            // an id of an arbitrary range of the image
+            mbediso_file* f = mbediso_fopen_id(fs, ((uint64_t)range.sector << 32) | bytes);
+            if(!f)
+                continue;
+
+            while(mbediso_fread(f, buffer.data(), 1, buffer.size()) == buffer.size())
+            {
+            }
+
+            mbediso_fclose(f);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        mbediso_get_stats(fs, &stats, false);
+        mbediso_closefs(fs);
+
+        if(!result.ok || seconds < result.seconds)
+            result.seconds = seconds;
+
+        result.stats = stats;
+        result.ok = true;
+    }
+
+    return result;
+}
+
+static void print_usage()
+{
+    fprintf(stderr, "Usage: lz4_pack_tune [options] <input.iso> <profile.mbpf>\n");
+    fprintf(stderr, "  -o  write the best archive to this file\n");
+    fprintf(stderr, "  -m  storage bandwidth in MB/s, used to weigh bytes read against decode time (default: 50)\n");
+    fprintf(stderr, "  -t  number of compression threads (default: one per hardware thread)\n");
+    fprintf(stderr, "  -a  adaptive compression levels\n");
+    fprintf(stderr, "  -s  stored-block threshold percentage (default: 50)\n");
+    fprintf(stderr, "  -b  write a big-endian block offset table\n");
+}
+
+int main(int argc, char** argv)
+{
+    LZ4Pack::Options options;
+    const char* out_fn = nullptr;
+    double bandwidth = 50;
+
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        std::string opt = argv[arg];
+
+        if(opt == "-b")
+            options.big_endian = true;
+        else if(opt == "-a")
+            options.adaptive = true;
+        else if(opt == "-s" && arg + 1 < argc)
+            options.stored_threshold = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-t" && arg + 1 < argc)
+            options.threads = (unsigned)strtoul(argv[++arg], nullptr, 10);
+        else if(opt == "-m" && arg + 1 < argc)
+            bandwidth = strtod(argv[++arg], nullptr);
+        else if(opt == "-o" && arg + 1 < argc)
+            out_fn = argv[++arg];
+        else
+        {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if(arg + 2 != argc || !(bandwidth > 0))
+    {
+        print_usage();
+        return -1;
+    }
+
+    const char* in_fn = argv[arg];
+
+    std::vector<TraceRange> trace;
+    if(!load_trace(trace, argv[arg + 1]))
+    {
+        fprintf(stderr, "Failed to read profile %s\n", argv[arg + 1]);
+        return -1;
+    }
+
+    const size_t block_sizes[] = {4*1024, 8*1024, 16*1024, 32*1024, 64*1024};
+    const uint32_t read_aheads[] = {16*1024, 64*1024, 256*1024, 1024*1024};
+
+    // the cost of a replay is its decode time plus the time to read its data from storage
+    auto cost = [bandwidth](const ReplayResult& r) {
+        return r.seconds + (double)r.stats.bytes_read / (bandwidth * 1e6);
+    };
+
+    printf("%-12s %-12s %14s %10s %12s %12s\n", "block size", "read-ahead", "bytes read", "decoded", "time (ms)", "cost (ms)");
+
+    ReplayResult baseline = replay(in_fn, trace, 0);
+    if(!baseline.ok)
+    {
+        fprintf(stderr, "Failed to open %s\n", in_fn);
+        return -1;
+    }
+
+    printf("%-12s %-12s %14llu %10llu %12.2f %12.2f\n", "(none)", "-", (unsigned long long)baseline.stats.bytes_read, 0ULL, baseline.seconds * 1000, cost(baseline) * 1000);
+
+    std::string best_fn;
+    size_t best_block_size = 0;
+    uint32_t best_read_ahead = 0;
+    double best_cost = std::numeric_limits<double>::infinity();
+
+    for(size_t block_size : block_sizes)
+    {
+        std::string candidate_fn = std::string(out_fn ? out_fn : in_fn) + ".tune-" + std::to_string(block_size / 1024) + "k";
+
+        FILE* inf = fopen(in_fn, "rb");
+        FILE* outf = fopen(candidate_fn.c_str(), "wb");
+
+        options.block_size = block_size;
+        bool packed = LZ4Pack::compress(outf, inf, options);
+
+        if(inf)
+            fclose(inf);
+        if(outf)
+            fclose(outf);
+
+        if(!packed)
+        {
+            fprintf(stderr, "Failed to pack %s at block size %zu\n", in_fn, block_size);
+            remove(candidate_fn.c_str());
+            continue;
+        }
+
+        bool is_best = false;
+
+        for(uint32_t read_ahead : read_aheads)
+        {
+            // a read-ahead below the block size reads single blocks, which the smallest larger setting already covers
+            if(read_ahead < block_size && read_ahead != read_aheads[0])
+                continue;
+
+            ReplayResult r = replay(candidate_fn.c_str(), trace, read_ahead);
+            if(!r.ok)
+                continue;
+
+            printf("%-12zu %-12u %14llu %10llu %12.2f %12.2f\n", block_size, read_ahead, (unsigned long long)r.stats.bytes_read, (unsigned long long)r.stats.blocks_decoded, r.seconds * 1000, cost(r) * 1000);
+
+            if(cost(r) < best_cost)
+            {
+                best_cost = cost(r);
+                best_block_size = block_size;
+                best_read_ahead = read_ahead;
+                is_best = true;
+            }
+        }
+
+        // keep only the best archive so far
+        if(is_best)
+        {
+            if(!best_fn.empty())
+                remove(best_fn.c_str());
+
+            best_fn = candidate_fn;
+        }
+        else
+            remove(candidate_fn.c_str());
+    }
+
+    if(best_fn.empty())
+        return -1;
+
+    printf("best: block size %zu, read-ahead %u (mbediso_set_read_ahead)\n", best_block_size, best_read_ahead);
+
+    if(out_fn)
+    {
+        remove(out_fn);
+        if(rename(best_fn.c_str(), out_fn) != 0)
+        {
+            fprintf(stderr, "Failed to write %s\n", out_fn);
+            return -1;
+        }
+    }
+    else
+        remove(best_fn.c_str());
+
+    return 0;
+}